@@ -5,10 +5,23 @@
 #include <apt-pkg/error.h>
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/indexfile.h>
+#include <apt-pkg/metaindex.h>
+#include <apt-pkg/mmap.h>
 #include <apt-pkg/pkgcache.h>
+#include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/policy.h>
 #include <apt-pkg/sourcelist.h>
+#include <apt-pkg/string_view.h>
 #include <apt-pkg/update.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Declared before the bridge so that it can name it.
+struct PkgTable;
 
 #include "oma-apt/src/raw/cache.rs"
 #include "oma-apt/src/raw/progress.rs"
@@ -31,13 +44,223 @@ inline Package Cache::begin() const {
 	return Package{ std::make_unique<PkgIterator>(safe_get_pkg_cache(ptr.get())->PkgBegin()) };
 }
 
+/// Fill the columns of every package in a single walk of the cache.
+inline PackageSnapshot Cache::snapshot() const {
+	pkgCache* cache = safe_get_pkg_cache(ptr.get());
+	pkgDepCache* depcache = ptr->GetDepCache();
+	uint32_t count = cache->Head().PackageCount;
+
+	PackageSnapshot snapshot;
+	snapshot.ids.reserve(count);
+	snapshot.offsets.reserve(2 * count + 1);
+	snapshot.current_state.reserve(count);
+	snapshot.inst_state.reserve(count);
+	snapshot.selected_state.reserve(count);
+	snapshot.flags.reserve(count);
+	snapshot.current_version.reserve(count);
+	snapshot.candidate_version.reserve(count);
+
+	std::string strings;
+	snapshot.offsets.push_back(0);
+
+	for (PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+		snapshot.ids.push_back(pkg->ID);
+
+		strings.append(pkg.Name());
+		snapshot.offsets.push_back(strings.size());
+		strings.append(pkg.Arch());
+		snapshot.offsets.push_back(strings.size());
+
+		snapshot.current_state.push_back(pkg->CurrentState);
+		snapshot.inst_state.push_back(pkg->InstState);
+		snapshot.selected_state.push_back(pkg->SelectedState);
+
+		uint8_t flags = 0;
+		if ((pkg->Flags & pkgCache::Flag::Essential) != 0) {
+			flags |= static_cast<uint8_t>(SnapshotFlag::Essential);
+		}
+		if (!pkg.VersionList().end()) {
+			flags |= static_cast<uint8_t>(SnapshotFlag::HasVersions);
+		}
+		snapshot.flags.push_back(flags);
+
+		VerIterator current = pkg.CurrentVer();
+		snapshot.current_version.push_back(current.end() ? NONE_ID : current->ID);
+
+		VerIterator candidate = depcache->GetCandidateVersion(pkg);
+		snapshot.candidate_version.push_back(candidate.end() ? NONE_ID : candidate->ID);
+	}
+
+	snapshot.strings = strings;
+	return snapshot;
+}
+
+/// The FilterFlag bits of a package.
+inline uint8_t filter_bits(const PkgIterator& pkg, pkgDepCache::StateCache& state) {
+	uint8_t bits = 0;
+	bool installed = !pkg.CurrentVer().end();
+
+	if (!pkg.VersionList().end()) bits |= static_cast<uint8_t>(FilterFlag::HasVersions);
+	if (installed) bits |= static_cast<uint8_t>(FilterFlag::Installed);
+	if (installed && state.Upgradable()) {
+		bits |= static_cast<uint8_t>(FilterFlag::Upgradable);
+	}
+	if (state.Flags & pkgCache::Flag::Auto) {
+		bits |= static_cast<uint8_t>(FilterFlag::AutoInstalled);
+	}
+	if ((installed || state.NewInstall()) && state.Garbage) {
+		bits |= static_cast<uint8_t>(FilterFlag::AutoRemovable);
+	}
+	return bits;
+}
+
+/// Check every package against the filter in a single loop.
+inline rust::Vec<uint32_t> Cache::filter_pkgs(const PackageFilter& filter) const {
+	pkgCache* cache = safe_get_pkg_cache(ptr.get());
+	pkgDepCache* depcache = ptr->GetDepCache();
+
+	std::vector<PkgIterator> matched;
+	for (PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+		uint8_t bits = filter_bits(pkg, (*depcache)[pkg]);
+		if ((bits & filter.require) != filter.require || (bits & filter.exclude) != 0) {
+			continue;
+		}
+		matched.push_back(pkg);
+	}
+
+	if (filter.names) {
+		std::stable_sort(matched.begin(), matched.end(),
+		[](const PkgIterator& a, const PkgIterator& b) {
+			return strcmp(a.Name(), b.Name()) < 0;
+		});
+	}
+
+	rust::Vec<uint32_t> ids;
+	ids.reserve(matched.size());
+	for (const PkgIterator& pkg : matched) {
+		ids.push_back(pkg->ID);
+	}
+	return ids;
+}
+
+/// Every package in the cache indexed by ID.
+struct PkgTable {
+	std::vector<PkgIterator> pkgs;
+
+	/// Return the packages for a list of IDs.
+	inline rust::Vec<Package> pkgs_by_id(rust::Slice<const uint32_t> ids) const {
+		rust::Vec<Package> out;
+		out.reserve(ids.size());
+		for (uint32_t id : ids) {
+			out.push_back(Package{ std::make_unique<PkgIterator>(pkg_from_table(pkgs, id)) });
+		}
+		return out;
+	}
+};
+
+/// Walk the packages once so that they can be found by ID after.
+inline std::unique_ptr<PkgTable> Cache::create_pkg_table() const {
+	return std::make_unique<PkgTable>(PkgTable{ pkg_id_table(*safe_get_pkg_cache(ptr.get())) });
+}
+
+/// Return a package for every name, in the same order.
+/// Packages that don't exist are end iterators in their position.
+inline rust::Vec<Package> Cache::find_pkgs(rust::Slice<const rust::Str> names) const {
+	pkgCache* cache = safe_get_pkg_cache(ptr.get());
+
+	rust::Vec<Package> pkgs;
+	pkgs.reserve(names.size());
+	for (rust::Str name : names) {
+		pkgs.push_back(Package{ std::make_unique<PkgIterator>(
+		cache->FindPkg(APT::StringView(name.data(), name.size()))) });
+	}
+	return pkgs;
+}
+
 /// The priority of the package as shown in `apt policy`.
 inline int32_t Cache::priority(const Version& ver) const noexcept {
 	return ptr->GetPolicy()->GetPriority(*ver.ptr);
 }
 
+/// Run `work(start, end)` over `0..size` split between every core.
+template <typename F>
+inline void split_work(size_t size, F work) {
+	size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), size);
+	if (threads <= 1) {
+		work(0, size);
+		return;
+	}
+
+	size_t chunk = (size + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	for (size_t start = chunk; start < size; start += chunk) {
+		workers.emplace_back(work, start, std::min(start + chunk, size));
+	}
+	work(0, std::min(chunk, size));
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+/// The priority of every version and the candidate of every package.
+///
+/// The policy and the DepCache are only read, so the columns are filled
+/// on many threads.
+inline PolicyTable Cache::policy_table() const {
+	pkgCache* cache = safe_get_pkg_cache(ptr.get());
+	pkgPolicy* policy = ptr->GetPolicy();
+	pkgDepCache* depcache = ptr->GetDepCache();
+	handle_errors();
+
+	std::vector<pkgCache::VerIterator> versions = ver_id_table(*cache);
+	std::vector<pkgCache::PkgIterator> pkgs = pkg_id_table(*cache);
+
+	std::vector<int32_t> priorities(versions.size(), 0);
+	split_work(versions.size(), [&](size_t start, size_t end) {
+		for (size_t id = start; id < end; id++) {
+			if (!versions[id].end()) {
+				priorities[id] = policy->GetPriority(versions[id]);
+			}
+		}
+	});
+
+	std::vector<uint32_t> candidates(pkgs.size(), NONE_ID);
+	split_work(pkgs.size(), [&](size_t start, size_t end) {
+		for (size_t id = start; id < end; id++) {
+			if (pkgs[id].end()) {
+				continue;
+			}
+			pkgCache::VerIterator cand = depcache->GetCandidateVersion(pkgs[id]);
+			if (!cand.end()) {
+				candidates[id] = cand->ID;
+			}
+		}
+	});
+
+	PolicyTable table;
+	table.priorities.reserve(priorities.size());
+	for (int32_t priority : priorities) {
+		table.priorities.push_back(priority);
+	}
+	table.candidates.reserve(candidates.size());
+	for (uint32_t candidate : candidates) {
+		table.candidates.push_back(candidate);
+	}
+	return table;
+}
+
 inline DepCache Cache::create_depcache() const noexcept {
-	return DepCache{ std::make_unique<PkgDepCache>(ptr->GetDepCache()) };
+	pkgDepCache* depcache = ptr->GetDepCache();
+	return DepCache{ std::make_unique<PkgDepCache>(depcache),
+		std::make_unique<ChangeJournal>(*depcache) };
+}
+
+/// Create a DepCache of its own that shares this cache and policy.
+inline std::unique_ptr<Simulation> Cache::create_simulation() const {
+	pkgCache* cache = safe_get_pkg_cache(ptr.get());
+	pkgPolicy* policy = ptr->GetPolicy();
+	handle_errors();
+	return std::make_unique<Simulation>(cache, policy);
 }
 
 inline std::unique_ptr<Records> Cache::create_records() const noexcept {
@@ -182,6 +405,158 @@ inline rust::Vec<SourceURI> Cache::source_uris() const noexcept {
 	return list;
 }
 
+/// Stat a file. Everything is zero if it doesn't exist.
+inline struct stat file_stat(const std::string& path) {
+	struct stat st;
+	if (path.empty() || stat(path.c_str(), &st) != 0) {
+		memset(&st, 0, sizeof(st));
+	}
+	return st;
+}
+
+/// True if a file was written between two stats. The caches are written
+/// to a new file that is renamed over the old one.
+inline bool file_written(const struct stat& before, const struct stat& after) {
+	return after.st_ino != 0 &&
+	(after.st_ino != before.st_ino || after.st_size != before.st_size ||
+	after.st_mtime != before.st_mtime);
+}
+
+/// How up to date pkgcache.bin or srcpkgcache.bin is for a list of index files.
+struct CacheFileCheck {
+	/// False if the file is missing or can't be mapped.
+	bool usable = false;
+	/// Index files that aren't in the cache file or have changed since.
+	std::vector<pkgIndexFile*> stale;
+	/// Files in the cache file that aren't in the list anymore.
+	uint32_t unused = 0;
+
+	inline bool up_to_date() const { return usable && stale.empty() && unused == 0; }
+};
+
+/// Check a cache file the way apt does before it reuses one.
+///
+/// The file is mapped read only on its own, and an index file is up to date
+/// if its size and time match what the cache file has for it.
+inline CacheFileCheck check_cache_file(
+const std::string& path, const std::vector<pkgIndexFile*>& files) {
+	CacheFileCheck check;
+	if (path.empty() || !FileExists(path)) {
+		return check;
+	}
+
+	// A broken cache file is only a reason to rebuild, not an error.
+	_error->PushToStack();
+	FileFd fd(path, FileFd::ReadOnly);
+	std::unique_ptr<MMap> map;
+	if (fd.IsOpen()) {
+		map = std::make_unique<MMap>(fd, MMap::Public | MMap::ReadOnly);
+	}
+	if (map != nullptr && !_error->PendingError() && map->validData()) {
+		pkgCache cache(map.get());
+		if (!_error->PendingError()) {
+			check.usable = true;
+			std::vector<bool> seen(cache.Head().PackageFileCount);
+			for (pkgIndexFile* file : files) {
+				pkgCache::PkgFileIterator found = file->FindInCache(cache);
+				if (found.end()) {
+					check.stale.push_back(file);
+				} else {
+					seen[found->ID] = true;
+				}
+			}
+			check.unused = std::count(seen.begin(), seen.end(), false);
+		}
+	}
+	_error->RevertToStack();
+	return check;
+}
+
+/// Open the cache one phase at a time, timing each.
+inline OpenProfile Cache::open_profile() const {
+	if (ptr->IsPkgCacheBuilt()) {
+		throw std::runtime_error("The cache has already been opened");
+	}
+
+	OpenProfile profile{};
+	auto time = [](const std::function<void()>& phase) -> uint64_t {
+		auto start = std::chrono::steady_clock::now();
+		phase();
+		handle_errors();
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start)
+		.count();
+	};
+
+	// Adding local debs reads the sources.list files in create_cache,
+	// so then that time is part of create.
+	if (!ptr->IsSrcListBuilt()) {
+		profile.sources_micros = time([&]() { ptr->BuildSourceList(); });
+	}
+
+	// The index files apt compares the caches against. srcpkgcache.bin only
+	// has the package lists, pkgcache.bin also has the dpkg status and debs.
+	pkgSourceList* list = ptr->GetSourceList();
+	std::vector<pkgIndexFile*> source_files;
+	for (metaIndex* meta : *list) {
+		for (pkgIndexFile* file : *meta->GetIndexFiles()) {
+			if (file->HasPackages() && file->Exists()) {
+				source_files.push_back(file);
+			}
+		}
+	}
+	std::vector<pkgIndexFile*> files = source_files;
+	_system->AddStatusFiles(files);
+	for (pkgIndexFile* file : list->GetVolatileFiles()) {
+		files.push_back(file);
+	}
+
+	std::string pkgcache = _config->FindFile("Dir::Cache::pkgcache");
+	std::string srcpkgcache = _config->FindFile("Dir::Cache::srcpkgcache");
+	CacheFileCheck pkgcache_check = check_cache_file(pkgcache, files);
+	CacheFileCheck srcpkgcache_check = check_cache_file(srcpkgcache, source_files);
+	struct stat pkgcache_before = file_stat(pkgcache);
+	struct stat srcpkgcache_before = file_stat(srcpkgcache);
+
+	profile.caches_micros = time([&]() { ptr->BuildCaches(nullptr, false); });
+
+	struct stat pkgcache_after = file_stat(pkgcache);
+	struct stat srcpkgcache_after = file_stat(srcpkgcache);
+	profile.pkgcache_written = file_written(pkgcache_before, pkgcache_after);
+	profile.srcpkgcache_written = file_written(srcpkgcache_before, srcpkgcache_after);
+	profile.pkgcache_size = ptr->GetPkgCache()->GetMap().Size();
+	profile.srcpkgcache_size = srcpkgcache_after.st_size;
+
+	profile.index_files = files.size();
+	profile.reused = pkgcache_check.up_to_date();
+	if (profile.reused) {
+		profile.reason = "pkgcache.bin is up to date";
+	} else if (!pkgcache_check.usable) {
+		profile.reason = "pkgcache.bin is missing or can't be used";
+	} else if (!pkgcache_check.stale.empty()) {
+		profile.reason = pkgcache_check.stale.front()->Describe(true) + " is new or has changed";
+		if (pkgcache_check.stale.size() > 1) {
+			profile.reason +=
+			" with " + std::to_string(pkgcache_check.stale.size() - 1) + " more";
+		}
+	} else {
+		profile.reason = "pkgcache.bin has index files that are no longer used";
+	}
+
+	// With an up to date srcpkgcache.bin only the rest is parsed.
+	if (profile.reused) {
+		profile.index_files_parsed = 0;
+	} else if (srcpkgcache_check.up_to_date()) {
+		profile.index_files_parsed = files.size() - source_files.size();
+	} else {
+		profile.index_files_parsed = files.size();
+	}
+
+	profile.policy_micros = time([&]() { ptr->BuildPolicy(); });
+	profile.depcache_micros = time([&]() { ptr->BuildDepCache(); });
+	return profile;
+}
+
 inline Cache create_cache(rust::Slice<const rust::String> deb_files) {
 	std::unique_ptr<pkgCacheFile> cache = std::make_unique<pkgCacheFile>();
 
@@ -2,10 +2,284 @@
 #include "rust/cxx.h"
 #include <apt-pkg/cachefile.h>
 #include <apt-pkg/upgrade.h>
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <vector>
 
 #include "oma-apt/src/raw/depcache.rs"
 
+/// The Package IDs whose marks changed.
+///
+/// apt has no way to be told when a mark changes, marking one package can
+/// mark many others. The journal keeps the mode of every package as it
+/// last saw it, and finds what changed by comparing the state of every
+/// package against that copy whenever it's asked, rather than once for
+/// every mark.
+///
+/// So each read is still a pass over every package, but in one loop here
+/// instead of a call over the bridge for each of them.
+///
+/// The package table and the copy are made the first time the journal is
+/// used, so a DepCache that never reads it doesn't pay for them.
+struct ChangeJournal {
+	pkgDepCache& depcache;
+	bool started;
+
+	/// Every package by ID, so the DepCache can be read without a lookup.
+	std::vector<pkgCache::PkgIterator> pkgs;
+	/// Where each package is in the cache's own order, by ID.
+	std::vector<uint32_t> order;
+	/// The mode of every package when last synced, and `REINSTALL`.
+	std::vector<uint8_t> shadow;
+
+	/// Changed since the journal was last reset.
+	std::vector<uint32_t> journal;
+	std::vector<bool> in_journal;
+
+	/// Changed since the journal started. This is what get_changes reads.
+	std::vector<uint32_t> touched;
+	std::vector<bool> in_touched;
+
+	static const uint8_t REINSTALL = 0x80;
+
+	static inline uint8_t mark(const pkgDepCache::StateCache& state) {
+		return state.Mode | (state.ReInstall() ? REINSTALL : 0);
+	}
+
+	ChangeJournal(pkgDepCache& depcache) : depcache(depcache), started(false){};
+
+	/// Take the package table and the first copy of the marks.
+	inline void start() {
+		if (started) {
+			return;
+		}
+
+		pkgCache& cache = depcache.GetCache();
+		size_t count = cache.Head().PackageCount;
+		pkgs.resize(count);
+		order.assign(count, 0);
+		shadow.assign(count, pkgDepCache::ModeKeep);
+		in_journal.assign(count, false);
+		in_touched.assign(count, false);
+
+		uint32_t position = 0;
+		for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+			uint32_t id = pkg->ID;
+			pkgs[id] = pkg;
+			order[id] = position++;
+			shadow[id] = mark(depcache[pkg]);
+			if (shadow[id] != pkgDepCache::ModeKeep) {
+				in_touched[id] = true;
+				touched.push_back(id);
+			}
+		}
+		started = true;
+	}
+
+	/// Look up Package IDs. Throws if any of them are not in the cache.
+	inline std::vector<pkgCache::PkgIterator> lookup(rust::Slice<const uint32_t> ids) {
+		start();
+
+		std::vector<pkgCache::PkgIterator> found;
+		found.reserve(ids.size());
+		for (uint32_t id : ids) {
+			found.push_back(pkg_from_table(pkgs, id));
+		}
+		return found;
+	}
+
+	/// Record every package whose mark changed since the last sync.
+	///
+	/// This is a pass over every package.
+	inline void sync() {
+		start();
+
+		for (size_t id = 0; id < pkgs.size(); id++) {
+			if (pkgs[id].end()) {
+				continue;
+			}
+			uint8_t now = mark(depcache[pkgs[id]]);
+			if (now == shadow[id]) {
+				continue;
+			}
+			shadow[id] = now;
+
+			if (!in_journal[id]) {
+				in_journal[id] = true;
+				journal.push_back(id);
+			}
+			if (!in_touched[id]) {
+				in_touched[id] = true;
+				touched.push_back(id);
+			}
+		}
+	}
+
+	/// Sync, and return the ID of every package that is marked to change,
+	/// in the same order as walking the cache.
+	inline std::vector<uint32_t> changed() {
+		sync();
+
+		std::vector<uint32_t> ids;
+		size_t kept = 0;
+		for (uint32_t id : touched) {
+			const pkgDepCache::StateCache& state = depcache[pkgs[id]];
+			if (state.NewInstall() || state.Delete() || state.Upgrade() || state.Downgrade() ||
+			state.ReInstall()) {
+				ids.push_back(id);
+			}
+
+			// Kept packages don't need checking until they change again.
+			if (shadow[id] != pkgDepCache::ModeKeep) {
+				touched[kept++] = id;
+			} else {
+				in_touched[id] = false;
+			}
+		}
+		touched.resize(kept);
+
+		std::sort(ids.begin(), ids.end(),
+		[&](uint32_t a, uint32_t b) { return order[a] < order[b]; });
+		return ids;
+	}
+};
+
+/// A copy of every mark in a DepCache, to restore later.
+struct DepCacheCheckpoint {
+	std::vector<pkgDepCache::StateCache> pkg_state;
+	std::vector<unsigned char> dep_state;
+
+	// The counters kept up to date with the marks.
+	long long usr_size;
+	unsigned long long download_size;
+	unsigned long inst_count;
+	unsigned long del_count;
+	unsigned long keep_count;
+	unsigned long broken_count;
+	unsigned long policy_broken_count;
+	unsigned long bad_count;
+};
+
+/// pkgDepCache keeps its state protected, and has no way to copy it.
+///
+/// A class derived from it can name those members, so member pointers are
+/// taken here and used on the real DepCache. Nothing is ever made of this type.
+struct DepCacheAccess : pkgDepCache {
+	static inline void save(pkgDepCache& depcache, DepCacheCheckpoint& checkpoint) {
+		const pkgCache::Header& head = depcache.GetCache().Head();
+		StateCache* pkg_state = depcache.*(&DepCacheAccess::PkgState);
+		unsigned char* dep_state = depcache.*(&DepCacheAccess::DepState);
+
+		checkpoint.pkg_state.assign(pkg_state, pkg_state + head.PackageCount);
+		checkpoint.dep_state.assign(dep_state, dep_state + head.DependsCount);
+
+		checkpoint.usr_size = depcache.*(&DepCacheAccess::iUsrSize);
+		checkpoint.download_size = depcache.*(&DepCacheAccess::iDownloadSize);
+		checkpoint.inst_count = depcache.*(&DepCacheAccess::iInstCount);
+		checkpoint.del_count = depcache.*(&DepCacheAccess::iDelCount);
+		checkpoint.keep_count = depcache.*(&DepCacheAccess::iKeepCount);
+		checkpoint.broken_count = depcache.*(&DepCacheAccess::iBrokenCount);
+		checkpoint.policy_broken_count = depcache.*(&DepCacheAccess::iPolicyBrokenCount);
+		checkpoint.bad_count = depcache.*(&DepCacheAccess::iBadCount);
+	}
+
+	static inline void restore(pkgDepCache& depcache, const DepCacheCheckpoint& checkpoint) {
+		const pkgCache::Header& head = depcache.GetCache().Head();
+		if (checkpoint.pkg_state.size() != head.PackageCount ||
+		checkpoint.dep_state.size() != head.DependsCount) {
+			throw std::runtime_error("Checkpoint is from a different cache");
+		}
+
+		memcpy(depcache.*(&DepCacheAccess::PkgState), checkpoint.pkg_state.data(),
+		checkpoint.pkg_state.size() * sizeof(StateCache));
+		memcpy(depcache.*(&DepCacheAccess::DepState), checkpoint.dep_state.data(),
+		checkpoint.dep_state.size());
+
+		depcache.*(&DepCacheAccess::iUsrSize) = checkpoint.usr_size;
+		depcache.*(&DepCacheAccess::iDownloadSize) = checkpoint.download_size;
+		depcache.*(&DepCacheAccess::iInstCount) = checkpoint.inst_count;
+		depcache.*(&DepCacheAccess::iDelCount) = checkpoint.del_count;
+		depcache.*(&DepCacheAccess::iKeepCount) = checkpoint.keep_count;
+		depcache.*(&DepCacheAccess::iBrokenCount) = checkpoint.broken_count;
+		depcache.*(&DepCacheAccess::iPolicyBrokenCount) = checkpoint.policy_broken_count;
+		depcache.*(&DepCacheAccess::iBadCount) = checkpoint.bad_count;
+	}
+};
+
+/// Run `operation` with a BudgetProgress, unless the budget has already run out.
+///
+/// apt can't be stopped midway, so the budget is checked before the
+/// operation, at every progress update and after it. If it ran out, the
+/// DepCache is put back the way it was before the operation.
+///
+/// `operation` returns false if it failed.
+template <typename Operation>
+inline BudgetStatus run_budgeted(
+pkgDepCache& depcache, DynOperationProgress& callback, Operation operation) {
+	BudgetProgress progress(callback);
+	if (progress.check()) {
+		return BudgetStatus::Exceeded;
+	}
+
+	DepCacheCheckpoint checkpoint;
+	DepCacheAccess::save(depcache, checkpoint);
+	bool finished = operation(progress);
+	if (progress.check()) {
+		DepCacheAccess::restore(depcache, checkpoint);
+		// Whatever apt said about the dropped operation is stale.
+		_error->Discard();
+		return BudgetStatus::Exceeded;
+	}
+	return finished ? BudgetStatus::Finished : BudgetStatus::Failed;
+}
+
+/// A DepCache of its own over the shared cache and policy,
+/// for trying out marks without touching the real DepCache.
+///
+/// Nothing shared is written, so many simulations can be used side by side.
+struct Simulation {
+	std::unique_ptr<pkgDepCache> depcache;
+	std::vector<pkgCache::PkgIterator> pkgs;
+	/// The marks right after Init, for `reset`.
+	DepCacheCheckpoint start;
+
+	inline pkgCache::PkgIterator pkg(uint32_t id) const { return pkg_from_table(pkgs, id); }
+
+	/// Mark a package for installation, by ID.
+	inline bool mark_install(uint32_t pkg_id, bool auto_inst) const {
+		return depcache->MarkInstall(pkg(pkg_id), auto_inst, 0, true, false);
+	}
+
+	/// Mark a package for removal, by ID.
+	inline bool mark_delete(uint32_t pkg_id, bool purge) const {
+		return depcache->MarkDelete(pkg(pkg_id), purge);
+	}
+
+	/// Run the problem resolver on this simulation.
+	inline void resolve(bool fix_broken) const {
+		pkgProblemResolver resolver(depcache.get());
+		resolver.Resolve(fix_broken);
+		handle_errors();
+	}
+
+	/// Put back the marks the simulation started with.
+	inline void reset() const { DepCacheAccess::restore(*depcache, start); }
+
+	inline uint64_t download_size() const { return depcache->DebSize(); }
+	inline int64_t disk_size() const { return depcache->UsrSize(); }
+	inline uint32_t install_count() const { return depcache->InstCount(); }
+	inline uint32_t delete_count() const { return depcache->DelCount(); }
+	inline uint32_t broken_count() const { return depcache->BrokenCount(); }
+
+	Simulation(pkgCache* cache, pkgDepCache::Policy* policy)
+	: depcache(new pkgDepCache(cache, policy)), pkgs(pkg_id_table(*cache)) {
+		depcache->Init(nullptr);
+		handle_errors();
+		DepCacheAccess::save(*depcache, start);
+	}
+};
+
 /// Clear any marked changes in the DepCache.
 inline void DepCache::init(DynOperationProgress& callback) const {
 	OpProgressWrapper op_progress(callback);
@@ -21,6 +295,11 @@ inline bool DepCache::fix_broken() const noexcept {
 	return pkgFixBroken(**ptr);
 }
 
+/// Like `fix_broken`, but within the callback's budget.
+inline BudgetStatus DepCache::fix_broken_budgeted(DynOperationProgress& callback) const {
+	return run_budgeted(**ptr, callback, [&](BudgetProgress&) { return pkgFixBroken(**ptr); });
+}
+
 inline ActionGroup DepCache::action_group() const noexcept {
 	return ActionGroup{ std::make_unique<PkgActionGroup>(**ptr) };
 }
@@ -149,6 +428,51 @@ const Package& pkg, bool auto_inst, bool from_user) const noexcept {
 	return (*ptr)->MarkInstall(*pkg.ptr, auto_inst, 0, from_user, false);
 }
 
+/// Mark many packages for installation, in order.
+///
+/// Every mark is made in one ActionGroup,
+/// so the autoremove sweep only runs once at the end.
+inline rust::Vec<bool> DepCache::mark_install_many(
+rust::Slice<const uint32_t> pkg_ids, bool auto_inst, bool from_user) const {
+	std::vector<pkgCache::PkgIterator> pkgs = journal_ptr->lookup(pkg_ids);
+
+	rust::Vec<bool> marked;
+	marked.reserve(pkgs.size());
+	pkgDepCache::ActionGroup group(**ptr);
+	for (const pkgCache::PkgIterator& pkg : pkgs) {
+		marked.push_back((*ptr)->MarkInstall(pkg, auto_inst, 0, from_user, false));
+	}
+	group.release();
+	return marked;
+}
+
+/// Mark many packages for removal, in one ActionGroup.
+inline rust::Vec<bool> DepCache::mark_delete_many(
+rust::Slice<const uint32_t> pkg_ids, bool purge) const {
+	std::vector<pkgCache::PkgIterator> pkgs = journal_ptr->lookup(pkg_ids);
+
+	rust::Vec<bool> marked;
+	marked.reserve(pkgs.size());
+	pkgDepCache::ActionGroup group(**ptr);
+	for (const pkgCache::PkgIterator& pkg : pkgs) {
+		marked.push_back((*ptr)->MarkDelete(pkg, purge));
+	}
+	group.release();
+	return marked;
+}
+
+/// Mark many packages as automatically or manually installed,
+/// in one ActionGroup.
+inline void DepCache::mark_auto_many(rust::Slice<const uint32_t> pkg_ids, bool mark_auto) const {
+	std::vector<pkgCache::PkgIterator> pkgs = journal_ptr->lookup(pkg_ids);
+
+	pkgDepCache::ActionGroup group(**ptr);
+	for (const pkgCache::PkgIterator& pkg : pkgs) {
+		(*ptr)->MarkAuto(pkg, mark_auto);
+	}
+	group.release();
+}
+
 /// Set a version to be the candidate of it's package.
 inline void DepCache::set_candidate_version(const Version& ver) const noexcept {
 	(*ptr)->SetCandidateVersion(*ver.ptr);
@@ -180,6 +504,105 @@ inline bool DepCache::is_inst_broken(const Package& pkg) const noexcept {
 	return (**ptr)[*pkg.ptr].InstBroken();
 }
 
+/// Return the state of every package, indexed by Package ID.
+inline rust::Vec<PkgState> DepCache::state_snapshot() const noexcept {
+	pkgDepCache& depcache = **ptr;
+	pkgCache& cache = depcache.GetCache();
+
+	rust::Vec<PkgState> states;
+	states.reserve(cache.Head().PackageCount);
+	for (uint32_t i = 0; i < cache.Head().PackageCount; i++) {
+		states.push_back(PkgState{ pkgDepCache::ModeKeep, 0, NONE_ID });
+	}
+
+	for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+		const pkgDepCache::StateCache& state = depcache[pkg];
+
+		uint16_t flags = 0;
+		auto set = [&flags](bool is, StateFlag flag) {
+			if (is) {
+				flags |= static_cast<uint16_t>(flag);
+			}
+		};
+		set(state.Flags & pkgCache::Flag::Auto, StateFlag::Auto);
+		set(state.Garbage, StateFlag::Garbage);
+		set(state.NowBroken(), StateFlag::NowBroken);
+		set(state.InstBroken(), StateFlag::InstBroken);
+		set(state.Upgradable(), StateFlag::Upgradable);
+		set(state.NewInstall(), StateFlag::NewInstall);
+		set(state.Upgrade(), StateFlag::Upgrade);
+		set(state.Downgrade(), StateFlag::Downgrade);
+		set(state.Delete(), StateFlag::Delete);
+		set(state.Purge(), StateFlag::Purge);
+		set(state.ReInstall(), StateFlag::ReInstall);
+		set(state.Keep(), StateFlag::Keep);
+
+		PkgState& out = states[pkg->ID];
+		out.mode = state.Mode;
+		out.flags = flags;
+		out.candidate = state.CandidateVer == nullptr ? NONE_ID : state.CandidateVer->ID;
+	}
+	return states;
+}
+
+/// Copy every mark and counter of the DepCache.
+///
+/// This allocates two arrays the size of the cache, so it can throw.
+inline std::unique_ptr<DepCacheCheckpoint> DepCache::checkpoint() const {
+	auto checkpoint = std::make_unique<DepCacheCheckpoint>();
+	DepCacheAccess::save(**ptr, *checkpoint);
+	return checkpoint;
+}
+
+/// Put back the marks and counters from a checkpoint.
+///
+/// This is a copy, nothing is recalculated.
+inline void DepCache::restore(const DepCacheCheckpoint& checkpoint) const {
+	DepCacheAccess::restore(**ptr, checkpoint);
+}
+
+/// Return the ID of every package whose mark changed since the journal
+/// was last reset, in the order they were found.
+inline rust::Vec<uint32_t> DepCache::journal() const noexcept {
+	journal_ptr->sync();
+
+	rust::Vec<uint32_t> ids;
+	ids.reserve(journal_ptr->journal.size());
+	for (uint32_t id : journal_ptr->journal) {
+		ids.push_back(id);
+	}
+	return ids;
+}
+
+/// Start the journal over from the current marks.
+inline void DepCache::reset_journal() const noexcept {
+	journal_ptr->sync();
+	for (uint32_t id : journal_ptr->journal) {
+		journal_ptr->in_journal[id] = false;
+	}
+	journal_ptr->journal.clear();
+}
+
+/// Return the ID of every package that is marked to change.
+inline rust::Vec<uint32_t> DepCache::changed_pkgs() const noexcept {
+	rust::Vec<uint32_t> ids;
+	for (uint32_t id : journal_ptr->changed()) {
+		ids.push_back(id);
+	}
+	return ids;
+}
+
+/// Return every package that is marked to change.
+///
+/// Packages come from the journal's own table, not a lookup by ID.
+inline rust::Vec<Package> DepCache::changed_packages() const noexcept {
+	rust::Vec<Package> pkgs;
+	for (uint32_t id : journal_ptr->changed()) {
+		pkgs.push_back(Package{ std::make_unique<pkgCache::PkgIterator>(journal_ptr->pkgs[id]) });
+	}
+	return pkgs;
+}
+
 /// The number of packages marked for installation.
 inline u_int32_t DepCache::install_count() const noexcept {
 	return (*ptr)->InstCount();
@@ -223,6 +646,23 @@ inline void DepCache::full_upgrade(DynOperationProgress& callback) const {
 	handle_errors();
 }
 
+/// Perform an upgrade within the callback's budget.
+inline BudgetStatus DepCache::upgrade_budgeted(
+bool allow_remove, bool allow_new, DynOperationProgress& callback) const {
+	int mode = APT::Upgrade::ALLOW_EVERYTHING;
+	if (!allow_remove) {
+		mode |= APT::Upgrade::FORBID_REMOVE_PACKAGES;
+	}
+	if (!allow_new) {
+		mode |= APT::Upgrade::FORBID_INSTALL_NEW_PACKAGES;
+	}
+
+	BudgetStatus status = run_budgeted(**ptr, callback,
+	[&](BudgetProgress& progress) { return APT::Upgrade::Upgrade(**ptr, mode, &progress); });
+	handle_errors();
+	return status;
+}
+
 /// Perform a Safe Upgrade. Neither remove or install new packages.
 inline void DepCache::safe_upgrade(DynOperationProgress& callback) const {
 	OpProgressWrapper op_progress(callback);
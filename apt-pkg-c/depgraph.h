@@ -0,0 +1,291 @@
+#pragma once
+#include "rust/cxx.h"
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/pkgcache.h>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "oma-apt/src/raw/depgraph.rs"
+
+/// Walk every dependency in the cache once and build the DepGraph.
+inline DepGraph create_dep_graph(const Cache& cache) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	const pkgCache::Header& head = pkg_cache->Head();
+
+	// Versions are walked by ID so that rows line up with the ID.
+	std::vector<pkgCache::VerIterator> versions = ver_id_table(*pkg_cache);
+
+	DepGraph graph;
+	graph.ver_offsets.reserve(head.VersionCount + 1);
+	graph.ver_pkgs.reserve(head.VersionCount);
+	graph.targets.reserve(head.DependsCount);
+	graph.parents.reserve(head.DependsCount);
+	graph.dep_types.reserve(head.DependsCount);
+	graph.comp_ops.reserve(head.DependsCount);
+	graph.target_versions.reserve(head.DependsCount);
+
+	// Index of each Dependency ID in the edge columns.
+	std::vector<uint32_t> edge_of(head.DependsCount, NONE_ID);
+
+	// Version strings are deduplicated by their offset in the cache.
+	std::unordered_map<map_stringitem_t, uint32_t> string_ids;
+	std::string strings;
+	graph.string_offsets.push_back(0);
+
+	for (uint32_t id = 0; id < versions.size(); id++) {
+		graph.ver_offsets.push_back(graph.targets.size());
+
+		// Every ID should have a version, skip any that don't.
+		if (versions[id].end()) {
+			graph.ver_pkgs.push_back(NONE_ID);
+			continue;
+		}
+		graph.ver_pkgs.push_back(versions[id].ParentPkg()->ID);
+
+		for (pkgCache::DepIterator dep = versions[id].DependsList(); !dep.end(); ++dep) {
+			edge_of[dep->ID] = graph.targets.size();
+
+			graph.targets.push_back(dep.TargetPkg()->ID);
+			graph.parents.push_back(id);
+			graph.dep_types.push_back(dep->Type);
+			graph.comp_ops.push_back(dep->CompareOp);
+
+			map_stringitem_t version = dep->Version;
+			if (version == 0) {
+				graph.target_versions.push_back(NONE_ID);
+				continue;
+			}
+
+			auto found = string_ids.find(version);
+			if (found == string_ids.end()) {
+				uint32_t string_id = graph.string_offsets.size() - 1;
+				strings.append(dep.TargetVer());
+				graph.string_offsets.push_back(strings.size());
+				found = string_ids.emplace(version, string_id).first;
+			}
+			graph.target_versions.push_back(found->second);
+		}
+	}
+	graph.ver_offsets.push_back(graph.targets.size());
+	graph.strings = strings;
+
+	// Reverse edges point back into the forward edge columns.
+	std::vector<pkgCache::PkgIterator> pkgs = pkg_id_table(*pkg_cache);
+	graph.pkg_offsets.reserve(pkgs.size() + 1);
+	graph.rev_edges.reserve(head.DependsCount);
+
+	graph.pkg_ver_offsets.reserve(pkgs.size() + 1);
+	graph.pkg_vers.reserve(head.VersionCount);
+	graph.provider_offsets.reserve(pkgs.size() + 1);
+	graph.provide_offsets.reserve(pkgs.size() + 1);
+
+	for (const pkgCache::PkgIterator& pkg : pkgs) {
+		graph.pkg_offsets.push_back(graph.rev_edges.size());
+		graph.pkg_ver_offsets.push_back(graph.pkg_vers.size());
+		graph.provider_offsets.push_back(graph.providers.size());
+		graph.provide_offsets.push_back(graph.provides.size());
+		if (pkg.end()) {
+			continue;
+		}
+
+		for (pkgCache::DepIterator dep = pkg.RevDependsList(); !dep.end(); ++dep) {
+			if (edge_of[dep->ID] != NONE_ID) {
+				graph.rev_edges.push_back(edge_of[dep->ID]);
+			}
+		}
+
+		for (pkgCache::PrvIterator prv = pkg.ProvidesList(); !prv.end(); ++prv) {
+			graph.providers.push_back(prv.OwnerPkg()->ID);
+		}
+
+		for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+			graph.pkg_vers.push_back(ver->ID);
+			for (pkgCache::PrvIterator prv = ver.ProvidesList(); !prv.end(); ++prv) {
+				graph.provides.push_back(prv.ParentPkg()->ID);
+			}
+		}
+	}
+	graph.pkg_offsets.push_back(graph.rev_edges.size());
+	graph.pkg_ver_offsets.push_back(graph.pkg_vers.size());
+	graph.provider_offsets.push_back(graph.providers.size());
+	graph.provide_offsets.push_back(graph.provides.size());
+
+	return graph;
+}
+
+/// Add every package that an edge can point the closure at.
+inline void closure_targets(
+const DepGraph& graph, const ClosureQuery& query, uint32_t edge, std::vector<uint32_t>& out) {
+	if (query.reverse) {
+		out.push_back(graph.ver_pkgs[graph.parents[edge]]);
+		return;
+	}
+
+	uint32_t target = graph.targets[edge];
+	out.push_back(target);
+	if (query.provides) {
+		for (uint32_t i = graph.provider_offsets[target]; i < graph.provider_offsets[target + 1]; i++) {
+			out.push_back(graph.providers[i]);
+		}
+	}
+}
+
+/// True if the edge has alternatives.
+/// An edge is in an Or group if it's Or'd with the next,
+/// or if the edge before it in the same version was.
+inline bool in_or_group(const DepGraph& graph, uint32_t edge) {
+	if ((graph.comp_ops[edge] & pkgCache::Dep::Or) == pkgCache::Dep::Or) {
+		return true;
+	}
+	return edge > graph.ver_offsets[graph.parents[edge]] &&
+	(graph.comp_ops[edge - 1] & pkgCache::Dep::Or) == pkgCache::Dep::Or;
+}
+
+/// Walk the closure of a single root and return the sorted Package IDs.
+///
+/// `seen` is scratch space owned by the calling thread,
+/// `stamp` must be different for every root the thread walks.
+inline std::vector<uint32_t> walk_closure(
+const DepGraph& graph,
+rust::Slice<const uint32_t> candidates,
+const ClosureQuery& query,
+uint32_t root,
+std::vector<uint32_t>& seen,
+uint32_t stamp) {
+	std::vector<uint32_t> ids;
+	std::vector<std::pair<uint32_t, uint32_t>> queue;
+	std::vector<uint32_t> targets;
+
+	seen[root] = stamp;
+	queue.emplace_back(root, 0);
+
+	for (size_t next = 0; next < queue.size(); next++) {
+		uint32_t pkg = queue[next].first;
+		uint32_t depth = queue[next].second;
+		if (query.max_depth != 0 && depth >= query.max_depth) {
+			continue;
+		}
+
+		targets.clear();
+		auto follow = [&](uint32_t edge) {
+			if ((query.dep_types & (1 << graph.dep_types[edge])) == 0) {
+				return;
+			}
+			if (!query.or_groups && in_or_group(graph, edge)) {
+				return;
+			}
+			if (query.candidates && query.reverse) {
+				uint32_t parent = graph.parents[edge];
+				if (candidates[graph.ver_pkgs[parent]] != parent) {
+					return;
+				}
+			}
+			closure_targets(graph, query, edge, targets);
+		};
+		auto follow_version = [&](uint32_t ver) {
+			for (uint32_t edge = graph.ver_offsets[ver]; edge < graph.ver_offsets[ver + 1]; edge++) {
+				follow(edge);
+			}
+		};
+		auto follow_rdepends = [&](uint32_t target) {
+			for (uint32_t i = graph.pkg_offsets[target]; i < graph.pkg_offsets[target + 1]; i++) {
+				follow(graph.rev_edges[i]);
+			}
+		};
+
+		if (query.reverse) {
+			// Anything depending on what this package provides depends on it.
+			follow_rdepends(pkg);
+			if (query.provides) {
+				for (uint32_t i = graph.provide_offsets[pkg]; i < graph.provide_offsets[pkg + 1]; i++) {
+					follow_rdepends(graph.provides[i]);
+				}
+			}
+		} else if (query.candidates) {
+			if (candidates[pkg] != NONE_ID) {
+				follow_version(candidates[pkg]);
+			}
+		} else {
+			for (uint32_t i = graph.pkg_ver_offsets[pkg]; i < graph.pkg_ver_offsets[pkg + 1]; i++) {
+				follow_version(graph.pkg_vers[i]);
+			}
+		}
+
+		for (uint32_t target : targets) {
+			if (seen[target] == stamp) {
+				continue;
+			}
+			seen[target] = stamp;
+			ids.push_back(target);
+			queue.emplace_back(target, depth + 1);
+		}
+	}
+
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+/// Return the closure of every root by walking the DepGraph.
+///
+/// `candidates` is the candidate Version ID of each package,
+/// it is only read if the query asks for candidates.
+/// Roots are split between threads, the graph is only read.
+inline ClosureSets dep_closure(
+const DepGraph& graph,
+rust::Slice<const uint32_t> candidates,
+rust::Slice<const uint32_t> roots,
+const ClosureQuery& query) {
+	if (query.dep_types == 0) {
+		throw std::runtime_error("The closure query doesn't follow any dependency types");
+	}
+
+	size_t pkg_count = graph.pkg_offsets.empty() ? 0 : graph.pkg_offsets.size() - 1;
+	if (query.candidates && candidates.size() != pkg_count) {
+		throw std::runtime_error("There must be a candidate for every package");
+	}
+
+	// Check every root first, threads can't throw back to rust.
+	for (uint32_t id : roots) {
+		if (id >= pkg_count) {
+			throw std::runtime_error("Package ID '" + std::to_string(id) + "' is not in the cache");
+		}
+	}
+
+	std::vector<std::vector<uint32_t>> results(roots.size());
+	std::atomic<size_t> next_root(0);
+
+	auto worker = [&]() {
+		std::vector<uint32_t> seen(pkg_count, 0);
+		uint32_t stamp = 0;
+		for (size_t i = next_root++; i < roots.size(); i = next_root++) {
+			results[i] = walk_closure(graph, candidates, query, roots[i], seen, ++stamp);
+		}
+	};
+
+	size_t thread_count =
+	std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), roots.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < thread_count; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	ClosureSets sets;
+	sets.offsets.reserve(results.size() + 1);
+	sets.offsets.push_back(0);
+	for (const std::vector<uint32_t>& ids : results) {
+		for (uint32_t id : ids) {
+			sets.ids.push_back(id);
+		}
+		sets.offsets.push_back(sets.ids.size());
+	}
+	return sets;
+}
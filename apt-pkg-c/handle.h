@@ -0,0 +1,216 @@
+#pragma once
+#include "rust/cxx.h"
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/pkgcache.h>
+#include <stdexcept>
+#include <string>
+
+#include "oma-apt/src/raw/handle.rs"
+
+/// Handles are the offset of an item in the cache. Offset 0 is the end.
+///
+/// Iterators are rebuilt on the stack from the offset,
+/// so none of these allocate.
+///
+/// Every handle is checked to be inside the cache before it is read,
+/// so a forged or end handle throws instead of reading past the map.
+
+/// Return the item at `offset` of a cache array,
+/// throwing if it is the end or isn't one of the `count` items in the cache.
+template <typename T>
+inline T* handle_ptr(pkgCache& cache, T* items, uint32_t offset, uint64_t count) {
+	if (offset == 0) {
+		throw std::runtime_error("Handle is the end of a list");
+	}
+	if ((offset + uint64_t(1)) * sizeof(T) > cache.GetMap().Size() || items[offset].ID >= count) {
+		throw std::runtime_error("Handle '" + std::to_string(offset) + "' is not in the cache");
+	}
+	return items + offset;
+}
+
+/// Get the PkgIterator of a handle.
+inline pkgCache::PkgIterator pkg_iter(const Cache& cache, PkgHandle pkg) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	return pkgCache::PkgIterator(*pkg_cache,
+	handle_ptr(*pkg_cache, pkg_cache->PkgP, pkg.offset, pkg_cache->Head().PackageCount));
+}
+
+/// Get the VerIterator of a handle.
+inline pkgCache::VerIterator ver_iter(const Cache& cache, VerHandle ver) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	return pkgCache::VerIterator(*pkg_cache,
+	handle_ptr(*pkg_cache, pkg_cache->VerP, ver.offset, pkg_cache->Head().VersionCount));
+}
+
+/// Get the DepIterator of a handle.
+inline pkgCache::DepIterator dep_iter(const Cache& cache, DepHandle dep) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	pkgCache::Dependency* ptr =
+	handle_ptr(*pkg_cache, pkg_cache->DepP, dep.offset, pkg_cache->Head().DependsCount);
+
+	// The type decides if the iterator follows the version or reverse list.
+	if (dep.reverse) {
+		return pkgCache::DepIterator(*pkg_cache, ptr, (pkgCache::Package*)nullptr);
+	}
+	return pkgCache::DepIterator(*pkg_cache, ptr, (pkgCache::Version*)nullptr);
+}
+
+/// Get the PrvIterator of a handle.
+inline pkgCache::PrvIterator prv_iter(const Cache& cache, PrvHandle prv) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	pkgCache::Provides* ptr =
+	handle_ptr(*pkg_cache, pkg_cache->ProvideP, prv.offset, pkg_cache->Head().ProvidesCount);
+
+	// The type decides if the iterator follows the package or version list.
+	if (prv.by_pkg) {
+		return pkgCache::PrvIterator(*pkg_cache, ptr, (pkgCache::Package*)nullptr);
+	}
+	return pkgCache::PrvIterator(*pkg_cache, ptr, (pkgCache::Version*)nullptr);
+}
+
+inline PkgHandle pkg_handle(const pkgCache::PkgIterator& pkg) {
+	return PkgHandle{ pkg.end() ? 0 : static_cast<uint32_t>(pkg.Index()) };
+}
+
+inline VerHandle ver_handle(const pkgCache::VerIterator& ver) {
+	return VerHandle{ static_cast<uint32_t>(ver.Index()) };
+}
+
+inline DepHandle dep_handle(const pkgCache::DepIterator& dep) {
+	return DepHandle{ static_cast<uint32_t>(dep.Index()), dep.Reverse() };
+}
+
+inline PrvHandle prv_handle(const pkgCache::PrvIterator& prv, bool by_pkg) {
+	return PrvHandle{ static_cast<uint32_t>(prv.Index()), by_pkg };
+}
+
+/// Return a handle to every package in the cache.
+inline rust::Vec<PkgHandle> all_pkgs(const Cache& cache) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+
+	rust::Vec<PkgHandle> pkgs;
+	pkgs.reserve(pkg_cache->Head().PackageCount);
+	for (pkgCache::PkgIterator pkg = pkg_cache->PkgBegin(); !pkg.end(); ++pkg) {
+		pkgs.push_back(pkg_handle(pkg));
+	}
+	return pkgs;
+}
+
+/// Return a package by name and optionally architecture.
+inline PkgHandle find_pkg_handle(const Cache& cache, rust::Str name) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	return pkg_handle(pkg_cache->FindPkg(std::string(name)));
+}
+
+// Package Handles
+
+inline rust::Str pkg_name(const Cache& cache, PkgHandle pkg) {
+	return handle_str(pkg_iter(cache, pkg).Name());
+}
+
+inline rust::Str pkg_arch(const Cache& cache, PkgHandle pkg) {
+	return handle_str(pkg_iter(cache, pkg).Arch());
+}
+
+inline uint32_t pkg_id(const Cache& cache, PkgHandle pkg) {
+	return pkg_iter(cache, pkg)->ID;
+}
+
+inline VerHandle pkg_current_ver(const Cache& cache, PkgHandle pkg) {
+	return ver_handle(pkg_iter(cache, pkg).CurrentVer());
+}
+
+inline VerHandle pkg_version_list(const Cache& cache, PkgHandle pkg) {
+	return ver_handle(pkg_iter(cache, pkg).VersionList());
+}
+
+inline DepHandle pkg_rev_depends(const Cache& cache, PkgHandle pkg) {
+	return dep_handle(pkg_iter(cache, pkg).RevDependsList());
+}
+
+inline PrvHandle pkg_provides(const Cache& cache, PkgHandle pkg) {
+	return prv_handle(pkg_iter(cache, pkg).ProvidesList(), true);
+}
+
+// Version Handles
+
+inline rust::Str ver_str(const Cache& cache, VerHandle ver) {
+	return handle_str(ver_iter(cache, ver).VerStr());
+}
+
+inline uint32_t ver_id(const Cache& cache, VerHandle ver) {
+	return ver_iter(cache, ver)->ID;
+}
+
+inline VerHandle ver_next(const Cache& cache, VerHandle ver) {
+	return ver_handle(++ver_iter(cache, ver));
+}
+
+inline PkgHandle ver_parent_pkg(const Cache& cache, VerHandle ver) {
+	return pkg_handle(ver_iter(cache, ver).ParentPkg());
+}
+
+inline DepHandle ver_depends(const Cache& cache, VerHandle ver) {
+	return dep_handle(ver_iter(cache, ver).DependsList());
+}
+
+inline PrvHandle ver_provides(const Cache& cache, VerHandle ver) {
+	return prv_handle(ver_iter(cache, ver).ProvidesList(), false);
+}
+
+// Dependency Handles
+
+inline DepHandle dep_next(const Cache& cache, DepHandle dep) {
+	return dep_handle(++dep_iter(cache, dep));
+}
+
+inline PkgHandle dep_target_pkg(const Cache& cache, DepHandle dep) {
+	return pkg_handle(dep_iter(cache, dep).TargetPkg());
+}
+
+inline PkgHandle dep_parent_pkg(const Cache& cache, DepHandle dep) {
+	return pkg_handle(dep_iter(cache, dep).ParentPkg());
+}
+
+inline VerHandle dep_parent_ver(const Cache& cache, DepHandle dep) {
+	return ver_handle(dep_iter(cache, dep).ParentVer());
+}
+
+inline uint8_t dep_type(const Cache& cache, DepHandle dep) {
+	return dep_iter(cache, dep)->Type;
+}
+
+/// True if this dep is Or'd with the next.
+inline bool dep_compare_op(const Cache& cache, DepHandle dep) {
+	return (dep_iter(cache, dep)->CompareOp & pkgCache::Dep::Or) == pkgCache::Dep::Or;
+}
+
+inline rust::Str dep_comp_type(const Cache& cache, DepHandle dep) {
+	return handle_str(dep_iter(cache, dep).CompType());
+}
+
+inline rust::Str dep_target_ver(const Cache& cache, DepHandle dep) {
+	return handle_str(dep_iter(cache, dep).TargetVer());
+}
+
+// Provider Handles
+
+inline PrvHandle prv_next(const Cache& cache, PrvHandle prv) {
+	return prv_handle(++prv_iter(cache, prv), prv.by_pkg);
+}
+
+inline rust::Str prv_name(const Cache& cache, PrvHandle prv) {
+	return handle_str(prv_iter(cache, prv).Name());
+}
+
+inline rust::Str prv_version_str(const Cache& cache, PrvHandle prv) {
+	return handle_str(prv_iter(cache, prv).ProvideVersion());
+}
+
+inline PkgHandle prv_target_pkg(const Cache& cache, PrvHandle prv) {
+	return pkg_handle(prv_iter(cache, prv).OwnerPkg());
+}
+
+inline VerHandle prv_target_ver(const Cache& cache, PrvHandle prv) {
+	return ver_handle(prv_iter(cache, prv).OwnerVer());
+}
@@ -6,7 +6,11 @@
 #include <apt-pkg/packagemanager.h>
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/sourcelist.h>
+#include <chrono>
 #include <memory>
+#include <vector>
+
+#include "oma-apt/src/raw/pkgmanager.rs"
 
 struct PackageManager {
 	pkgPackageManager mutable* pkgmanager;
@@ -75,6 +79,7 @@ struct PackageManager {
 };
 
 struct ProblemResolver {
+	pkgDepCache* depcache;
 	pkgProblemResolver mutable resolver;
 
 	/// Mark a package as protected, i.e. don't let its installation/removal state change when modifying packages during resolution.
@@ -89,7 +94,63 @@ struct ProblemResolver {
 		handle_errors();
 	}
 
-	ProblemResolver(pkgDepCache* depcache) : resolver(depcache){};
+	/// Resolve like `resolve`, but within the callback's budget.
+	inline BudgetStatus resolve_budgeted(bool fix_broken, DynOperationProgress& callback) const {
+		BudgetStatus status = run_budgeted(*depcache, callback,
+		[&](BudgetProgress& progress) { return resolver.Resolve(fix_broken, &progress); });
+		handle_errors();
+		return status;
+	}
+
+	/// Resolve like `resolve` and measure how it went.
+	///
+	/// The solve is timed here, and what it did is counted by comparing the
+	/// mode of every package before and after it.
+	inline ResolverStats resolve_with_stats(bool fix_broken, DynOperationProgress& callback) const {
+		pkgCache& cache = depcache->GetCache();
+		ResolverStats stats{};
+		stats.broken_before = depcache->BrokenCount();
+
+		std::vector<uint8_t> before(cache.Head().PackageCount);
+		for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+			before[pkg->ID] = (*depcache)[pkg].Mode;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		{
+			OpProgressWrapper op_progress(callback);
+			stats.resolved = resolver.Resolve(fix_broken, &op_progress);
+		}
+		stats.micros = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start)
+		               .count();
+
+		// A failed solve is still measured, its errors are returned with it.
+		try {
+			handle_errors();
+		} catch (const std::runtime_error& err) {
+			stats.resolved = false;
+			stats.error = err.what();
+		}
+
+		stats.broken_after = depcache->BrokenCount();
+		for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+			uint8_t mode = (*depcache)[pkg].Mode;
+			if (mode == before[pkg->ID]) {
+				continue;
+			}
+			if (mode == pkgDepCache::ModeKeep) {
+				stats.kept++;
+			} else if (mode == pkgDepCache::ModeDelete) {
+				stats.removed++;
+			} else if (mode == pkgDepCache::ModeInstall) {
+				stats.installed++;
+			}
+		}
+		return stats;
+	}
+
+	ProblemResolver(pkgDepCache* depcache) : depcache(depcache), resolver(depcache){};
 };
 
 /// Create the problem resolver.
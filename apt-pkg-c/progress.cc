@@ -208,6 +208,22 @@ void OpProgressWrapper::Update() { op_update(callback, Op, Percent); }
 
 void OpProgressWrapper::Done() { op_done(callback); }
 
+/// Calls for budgeted OpProgress usage.
+BudgetProgress::BudgetProgress(DynOperationProgress& callback)
+: OpProgressWrapper(callback), exceeded(false) {}
+
+bool BudgetProgress::check() {
+	if (!exceeded) {
+		exceeded = op_cancelled(callback);
+	}
+	return exceeded;
+}
+
+void BudgetProgress::Update() {
+	OpProgressWrapper::Update();
+	check();
+}
+
 /// Calls for InstallProgress usage.
 PackageManagerWrapper::PackageManagerWrapper(DynInstallProgress& callback)
 : callback(callback) {}
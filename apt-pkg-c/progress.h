@@ -63,6 +63,7 @@ class DynOperationProgress {
 };
 
 class OpProgressWrapper : public OpProgress {
+	protected:
 	/// Callback to the rust struct
 	DynOperationProgress& callback;
 
@@ -73,6 +74,21 @@ class OpProgressWrapper : public OpProgress {
 	OpProgressWrapper(DynOperationProgress& callback);
 };
 
+/// An OpProgressWrapper that also asks the callback if it has cancelled.
+///
+/// apt can't be stopped from a progress, so this only remembers the answer.
+/// It is asked at every Update and whenever `check` is called.
+class BudgetProgress : public OpProgressWrapper {
+	bool exceeded;
+
+	public:
+	void Update();
+	/// Return true once the callback has cancelled.
+	bool check();
+
+	BudgetProgress(DynOperationProgress& callback);
+};
+
 /// Classes for InstallProgress usage.
 class DynInstallProgress {
 	public:
@@ -6,36 +6,239 @@
 #include <apt-pkg/pkgrecords.h>
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/sourcelist.h>
+#include <apt-pkg/tagfile.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "oma-apt/src/raw/records.rs"
+
+/// A record copied out of its package file.
+///
+/// Entries are shared with rust, so fields can be borrowed from them
+/// for as long as rust holds on to the entry.
+///
+/// Values the parser works out itself, such as the translated descriptions,
+/// are read from the package file the first time they are asked for.
+struct RecordEntry {
+	using Lookup = std::function<pkgRecords::Parser&(pkgRecords&)>;
+
+	std::string text;
+	pkgTagSection section;
+	std::weak_ptr<pkgRecords> records;
+	Lookup lookup;
+
+	bool mutable has_descs;
+	std::string mutable long_desc;
+	std::string mutable short_desc;
+	bool mutable has_file_name;
+	std::string mutable file_name;
+	bool mutable has_hashes;
+	std::vector<std::pair<std::string, std::string>> mutable hashes;
+
+	RecordEntry(const std::shared_ptr<pkgRecords>& records, Lookup lookup)
+	: records(records), lookup(std::move(lookup)), has_descs(false), has_file_name(false),
+	  has_hashes(false) {
+		const char* start;
+		const char* stop;
+		this->lookup(*records).GetRec(start, stop);
+
+		// The section points into the text, so it can't be moved after this.
+		// An extra newline makes sure the section is terminated.
+		text.assign(start, stop);
+		text.append("\n");
+		if (!section.Scan(text.c_str(), text.size())) {
+			throw std::runtime_error("Unable to parse the record");
+		}
+	}
+
+	// The section points into our own text, a copy would point into the old one.
+	RecordEntry(const RecordEntry&) = delete;
+	RecordEntry& operator=(const RecordEntry&) = delete;
+	RecordEntry(RecordEntry&&) = delete;
+	RecordEntry& operator=(RecordEntry&&) = delete;
+
+	/// Move the parser back to this record.
+	inline pkgRecords::Parser& parser() const {
+		std::shared_ptr<pkgRecords> records = this->records.lock();
+		if (!records) {
+			throw std::runtime_error("The records this entry came from are gone");
+		}
+		pkgRecords::Parser& parser = lookup(*records);
+		handle_errors();
+		return parser;
+	}
+
+	/// Return the translated long description, empty if there is none.
+	inline const std::string& read_long_desc() const {
+		read_descs();
+		return long_desc;
+	}
+
+	/// Return the translated short description, empty if there is none.
+	inline const std::string& read_short_desc() const {
+		read_descs();
+		return short_desc;
+	}
+
+	inline void read_descs() const {
+		if (!has_descs) {
+			pkgRecords::Parser& parse = parser();
+			long_desc = parse.LongDesc();
+			short_desc = parse.ShortDesc();
+			has_descs = true;
+		}
+	}
+
+	/// Return the name of the file in the archive, empty if there is none.
+	inline const std::string& read_file_name() const {
+		if (!has_file_name) {
+			file_name = parser().FileName();
+			has_file_name = true;
+		}
+		return file_name;
+	}
+
+	/// Return the value of a field in the record.
+	inline rust::Str field(rust::Str key) const { return section_find(section, key); }
+
+	/// Return the translated long description.
+	inline rust::Str long_description() const { return handle_str(read_long_desc().c_str()); }
+
+	/// Return the translated short description.
+	inline rust::Str short_description() const { return handle_str(read_short_desc().c_str()); }
+
+	/// Return the name of the file in the archive.
+	inline rust::Str filename() const { return handle_str(read_file_name().c_str()); }
+
+	/// Find a hash by type, such as "sha256".
+	inline rust::Str hash(rust::Str hash_type) const {
+		if (!has_hashes) {
+			for (const HashString& hash : parser().Hashes()) {
+				hashes.emplace_back(hash.HashType(), hash.HashValue());
+			}
+			has_hashes = true;
+		}
+
+		for (const auto& hash : hashes) {
+			if (hash.first.size() == hash_type.size() &&
+			strncasecmp(hash.first.data(), hash_type.data(), hash_type.size()) == 0) {
+				return handle_str(hash.second.c_str());
+			}
+		}
+		throw std::runtime_error("Hash Not Found");
+	}
+
+	/// The number of fields in the record.
+	inline uint32_t field_count() const { return section.Count(); }
+
+	/// Return the key of the field at an index.
+	inline rust::Str key_at(uint32_t index) const { return section_key_at(section, index); }
+
+	/// Return the value of the field at an index.
+	inline rust::Str value_at(uint32_t index) const { return section_value_at(section, index); }
+};
+
+/// A bounded LRU of records keyed by package file ID and offset.
+struct RecordLru {
+	using Key = std::pair<uint32_t, uint64_t>;
+	using Entry = std::pair<Key, std::shared_ptr<RecordEntry>>;
+
+	size_t capacity;
+	uint64_t hits;
+	uint64_t misses;
+	std::list<Entry> entries;
+	std::map<Key, std::list<Entry>::iterator> index;
+
+	/// Return the record for a key, `create` it if it's not cached.
+	template <typename Create>
+	inline const std::shared_ptr<RecordEntry>& get(const Key& key, Create create) {
+		auto found = index.find(key);
+		if (found != index.end()) {
+			hits++;
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->second;
+		}
+
+		misses++;
+		entries.emplace_front(key, create());
+		index[key] = entries.begin();
+		trim();
+		return entries.front().second;
+	}
+
+	/// Drop the least recently used records until we fit.
+	/// The newest record is always kept.
+	inline void trim() {
+		while (entries.size() > std::max<size_t>(capacity, 1)) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+	}
+
+	RecordLru(size_t capacity) : capacity(capacity), hits(0), misses(0){};
+};
 
 /// Package Record Management:
 struct Records {
-	pkgRecords mutable records;
-	pkgRecords::Parser mutable* parser;
-	u_int64_t mutable last;
+	std::shared_ptr<pkgRecords> records;
+	RecordLru mutable ver_records;
+	RecordLru mutable desc_records;
+	std::shared_ptr<RecordEntry> mutable current;
+	pkgCache* cache;
 
-	inline bool already_has(u_int64_t index) const {
-		if (last == index) {
-			return true;
-		}
-		last = index;
-		return false;
+	/// Return the record of a version file.
+	inline std::shared_ptr<RecordEntry> ver_record(const VersionFile& ver_file) const {
+		pkgCache::VerFileIterator file = *ver_file.ptr;
+		return ver_records.get(RecordLru::Key(file.File()->ID, file->Offset), [&]() {
+			return std::make_shared<RecordEntry>(records,
+			[file](pkgRecords& records) -> pkgRecords::Parser& { return records.Lookup(file); });
+		});
+	}
+
+	/// Return the record of a description file.
+	inline std::shared_ptr<RecordEntry> desc_record(const DescriptionFile& desc_file) const {
+		pkgCache::DescFileIterator file = *desc_file.ptr;
+		return desc_records.get(RecordLru::Key(file.File()->ID, file->Offset), [&]() {
+			return std::make_shared<RecordEntry>(records,
+			[file](pkgRecords& records) -> pkgRecords::Parser& { return records.Lookup(file); });
+		});
 	}
 
 	/// Moves the Records into the correct place.
 	inline void ver_file_lookup(const VersionFile& ver_file) const {
-		if (this->already_has(ver_file.index())) {
-			return;
-		}
-		this->parser = &records.Lookup(*ver_file.ptr);
+		current = ver_record(ver_file);
 	}
 
 	/// Moves the Records into the correct place.
 	inline void desc_file_lookup(const DescriptionFile& desc_file) const {
-		if (this->already_has(desc_file.index())) {
-			return;
-		}
-		this->parser = &records.Lookup(*desc_file.ptr);
+		current = desc_record(desc_file);
+	}
+
+	/// Set how many records of each kind to keep.
+	inline void set_cache_size(size_t size) const {
+		ver_records.capacity = size;
+		ver_records.trim();
+		desc_records.capacity = size;
+		desc_records.trim();
+	}
+
+	/// Return how often lookups were already cached.
+	inline RecordCacheStats cache_stats() const {
+		return RecordCacheStats{
+			ver_records.hits,
+			ver_records.misses,
+			desc_records.hits,
+			desc_records.misses,
+		};
 	}
 
 	/// Return the URI for a version as determined by it's package file.
@@ -45,40 +248,213 @@ struct Records {
 			throw std::runtime_error(
 			"You have to run 'cache.find_index()' first!");
 		}
-		if (!parser) {
+		if (!current) {
 			throw std::runtime_error(
 			"You have to run 'cache.ver_lookup()' or 'desc_lookup()' first!");
 		}
-		return (*pkg_file.index_file)->ArchiveURI(parser->FileName());
+		return (*pkg_file.index_file)->ArchiveURI(current->read_file_name());
 	}
 
 	/// Return the translated long description of a Package.
 	inline rust::string long_desc() const {
-		return handle_string(parser->LongDesc());
+		return handle_string(current->read_long_desc());
 	}
 
 	/// Return the translated short description of a Package.
 	inline rust::string short_desc() const {
-		return handle_string(parser->ShortDesc());
+		return handle_string(current->read_short_desc());
 	}
 
 	/// Return the Source package version string.
 	inline rust::string get_field(rust::string field) const {
-		return handle_string(parser->RecordField(field.c_str()));
+		return handle_string(current->section.FindS(field.c_str()));
 	}
 
 	/// Find the hash of a Version. Returns Result if there is no hash.
 	inline rust::string hash_find(rust::string hash_type) const {
-		auto hashes = parser->Hashes();
-		auto hash = hashes.find(hash_type.c_str());
-		if (hash == NULL) {
-			throw std::runtime_error("Hash Not Found");
+		return rust::string(current->hash(hash_type));
+	}
+
+	/// A version file to read and the row its fields go in.
+	struct FieldLookup {
+		pkgCache::VerFileIterator ver_file;
+		size_t row;
+	};
+
+	/// Find the record of every Version ID,
+	/// sorted by package file and then offset.
+	inline std::vector<FieldLookup> field_lookups(rust::Slice<const uint32_t> ver_ids) const {
+		std::vector<pkgCache::VerIterator> versions = ver_id_table(*cache);
+
+		std::vector<FieldLookup> lookups;
+		lookups.reserve(ver_ids.size());
+		for (size_t row = 0; row < ver_ids.size(); row++) {
+			pkgCache::VerFileIterator ver_file =
+			ver_from_table(versions, ver_ids[row]).FileList();
+			if (!ver_file.end()) {
+				lookups.push_back(FieldLookup{ ver_file, row });
+			}
+		}
+
+		std::sort(lookups.begin(), lookups.end(), [](const FieldLookup& a, const FieldLookup& b) {
+			if (a.ver_file->File != b.ver_file->File) {
+				return a.ver_file->File < b.ver_file->File;
+			}
+			return a.ver_file->Offset < b.ver_file->Offset;
+		});
+		return lookups;
+	}
+
+	/// Read the fields of a run of lookups into their cells.
+	///
+	/// Stops at the first lookup that fails,
+	/// the error is left on `_error` of the calling thread.
+	static inline void read_fields(pkgRecords& records,
+	std::vector<FieldLookup>::const_iterator begin,
+	std::vector<FieldLookup>::const_iterator end,
+	const std::vector<std::string>& names,
+	std::vector<std::string>& cells) {
+		for (auto lookup = begin; lookup != end; ++lookup) {
+			pkgRecords::Parser& parse = records.Lookup(lookup->ver_file);
+			if (_error->PendingError()) {
+				return;
+			}
+			for (size_t col = 0; col < names.size(); col++) {
+				cells[lookup->row * names.size() + col] = parse.RecordField(names[col].c_str());
+			}
+		}
+	}
+
+	static inline std::vector<std::string> field_names(rust::Slice<const rust::Str> fields) {
+		std::vector<std::string> names;
+		names.reserve(fields.size());
+		for (rust::Str field : fields) {
+			names.push_back(std::string(field));
+		}
+		return names;
+	}
+
+	static inline RecordTable pack_fields(const std::vector<std::string>& cells, size_t columns) {
+		RecordTable table;
+		table.columns = columns;
+		table.offsets.reserve(cells.size() + 1);
+		table.offsets.push_back(0);
+
+		size_t size = 0;
+		for (const std::string& cell : cells) {
+			size += cell.size();
+		}
+		table.data.reserve(size);
+
+		// rust::Vec can only push one byte at a time, let rust copy each cell.
+		for (const std::string& cell : cells) {
+			extend_data(table,
+			rust::Slice<const uint8_t>(reinterpret_cast<const uint8_t*>(cell.data()), cell.size()));
+			table.offsets.push_back(table.data.size());
+		}
+		return table;
+	}
+
+	/// Get record fields of many versions at once.
+	///
+	/// Lookups are sorted by package file and offset,
+	/// so each file is read front to back once.
+	inline RecordTable bulk_fields(
+	rust::Slice<const uint32_t> ver_ids, rust::Slice<const rust::Str> fields) const {
+		std::vector<FieldLookup> lookups = field_lookups(ver_ids);
+		std::vector<std::string> names = field_names(fields);
+
+		std::vector<std::string> cells(ver_ids.size() * names.size());
+		read_fields(*records, lookups.begin(), lookups.end(), names, cells);
+		handle_errors();
+		return pack_fields(cells, names.size());
+	}
+
+	/// Like `bulk_fields`, but read on many threads.
+	///
+	/// Every thread has its own pkgRecords over the same cache.
+	/// Lookups are split into shards that never span package files,
+	/// and each shard is read front to back by one thread.
+	inline RecordTable parallel_fields(rust::Slice<const uint32_t> ver_ids,
+	rust::Slice<const rust::Str> fields,
+	size_t threads) const {
+		std::vector<FieldLookup> lookups = field_lookups(ver_ids);
+		std::vector<std::string> names = field_names(fields);
+
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threads = std::max<size_t>(std::min(threads, lookups.size()), 1);
+
+		// A few shards per thread so one large file doesn't end up on one thread.
+		size_t shard_size = std::max<size_t>(lookups.size() / (threads * 4), 1);
+		std::vector<std::pair<size_t, size_t>> shards;
+		for (size_t start = 0; start < lookups.size();) {
+			size_t end = start + 1;
+			while (end < lookups.size() && end - start < shard_size &&
+			lookups[end].ver_file->File == lookups[start].ver_file->File) {
+				end++;
+			}
+			shards.emplace_back(start, end);
+			start = end;
+		}
+
+		// pkgRecords opens every package file, do that before threads start.
+		std::vector<std::unique_ptr<pkgRecords>> readers;
+		for (size_t i = 0; i < threads; i++) {
+			readers.push_back(std::make_unique<pkgRecords>(*cache));
+		}
+		handle_errors();
+
+		std::vector<std::string> cells(ver_ids.size() * names.size());
+		std::atomic<size_t> next_shard(0);
+
+		// `_error` is per thread, and threads can't throw back to rust.
+		// Each worker keeps its errors here and they are thrown after the join.
+		std::mutex errors_lock;
+		std::vector<std::string> errors;
+		std::atomic<bool> failed(false);
+
+		auto worker = [&](pkgRecords& reader) {
+			for (size_t i = next_shard++; i < shards.size() && !failed; i = next_shard++) {
+				read_fields(reader, lookups.begin() + shards[i].first,
+				lookups.begin() + shards[i].second, names, cells);
+				if (_error->PendingError()) {
+					failed = true;
+				}
+			}
+
+			try {
+				handle_errors();
+			} catch (const std::runtime_error& err) {
+				std::lock_guard<std::mutex> guard(errors_lock);
+				errors.push_back(err.what());
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threads; i++) {
+			workers.emplace_back(worker, std::ref(*readers[i]));
+		}
+		worker(*readers[0]);
+		for (std::thread& thread : workers) {
+			thread.join();
+		}
+
+		if (!errors.empty()) {
+			std::string message = errors[0];
+			for (size_t i = 1; i < errors.size(); i++) {
+				message.append(";" + errors[i]);
+			}
+			throw std::runtime_error(message);
 		}
-		return handle_string(hash->HashValue());
+		return pack_fields(cells, names.size());
 	}
 
 	Records(const std::unique_ptr<pkgCacheFile>& cache)
-	: records(*safe_get_pkg_cache(cache.get())), parser(0), last(0){};
+	: records(std::make_shared<pkgRecords>(*safe_get_pkg_cache(cache.get()))),
+	  ver_records(16), desc_records(16),
+	  current(), cache(cache->GetPkgCache()){};
 
 	/// UniquePtr Constructor
 	static std::unique_ptr<Records> Unique(const std::unique_ptr<pkgCacheFile>& cache) {
@@ -0,0 +1,394 @@
+#pragma once
+#include "rust/cxx.h"
+#include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/mmap.h>
+#include <apt-pkg/pkgcache.h>
+#include <apt-pkg/pkgrecords.h>
+#include <apt-pkg/string_view.h>
+#include <apt-pkg/strutl.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "oma-apt/src/raw/search.rs"
+
+/// Layout of a search index file.
+///
+/// The header, then `term_count` SearchTerms sorted by term,
+/// then `posting_count` SearchPostings, then every term back to back.
+/// Numbers are native endian, the index is only read where it was written.
+struct SearchHeader {
+	char magic[4];
+	uint32_t version;
+	/// From `search_index_key`, the index is rebuilt when it changes.
+	uint64_t key;
+	uint32_t term_count;
+	uint32_t posting_count;
+	uint32_t strings_size;
+	uint32_t padding;
+};
+
+const char SEARCH_MAGIC[4] = { 'O', 'M', 'A', 'S' };
+const uint32_t SEARCH_VERSION = 2;
+
+/// A term and the packages it was found in.
+struct SearchTerm {
+	uint32_t string_offset;
+	uint32_t string_size;
+	uint32_t posting_offset;
+	uint32_t posting_count;
+};
+
+/// A package a term was found in. Postings of a term are sorted by ID.
+struct SearchPosting {
+	uint32_t pkg_id;
+	/// SearchField bits of where the term was found.
+	uint32_t fields;
+};
+
+/// Terms are runs of ASCII letters and digits, lowercased.
+/// Shorter terms match too much to be useful, longer terms are noise.
+const size_t SEARCH_MIN_TERM = 2;
+const size_t SEARCH_MAX_TERM = 64;
+
+/// Call `emit` with every term in some text.
+template <typename F>
+inline void search_terms(const std::string& text, F emit) {
+	std::string term;
+	for (size_t i = 0; i <= text.size(); i++) {
+		char c = i < text.size() ? text[i] : ' ';
+		if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+			term.push_back(tolower_ascii(c));
+			continue;
+		}
+		if (term.size() >= SEARCH_MIN_TERM && term.size() <= SEARCH_MAX_TERM) {
+			emit(term);
+		}
+		term.clear();
+	}
+}
+
+/// A key that changes whenever the cache could have different packages
+/// or descriptions: the item counts of the cache,
+/// the name, mtime and size of every file it was built from,
+/// and the languages descriptions are translated to.
+inline uint64_t search_index_key(pkgCache& cache) {
+	// FNV-1a, this only needs to notice a change.
+	uint64_t key = 14695981039346656037ull;
+	auto mix = [&key](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			key = (key ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+
+	const pkgCache::Header& head = cache.Head();
+	mix(&head.PackageCount, sizeof(head.PackageCount));
+	mix(&head.VersionCount, sizeof(head.VersionCount));
+	mix(&head.DescriptionCount, sizeof(head.DescriptionCount));
+
+	for (pkgCache::PkgFileIterator file = cache.FileBegin(); !file.end(); ++file) {
+		const char* name = file.FileName();
+		if (name != nullptr) {
+			mix(name, strlen(name) + 1);
+		}
+		mix(&file->mtime, sizeof(file->mtime));
+		mix(&file->Size, sizeof(file->Size));
+	}
+
+	for (const std::string& lang : APT::Configuration::getLanguages()) {
+		mix(lang.c_str(), lang.size() + 1);
+	}
+	return key;
+}
+
+/// Read the name and description of every package and write the index.
+///
+/// The newest version of each package is indexed.
+/// The file is replaced atomically, readers never see half an index.
+inline void write_search_index(pkgCache& cache, uint64_t key, const std::string& path) {
+	std::unordered_map<std::string, std::vector<SearchPosting>> postings;
+
+	// Terms of the package being read, and where they were found.
+	std::unordered_map<std::string, uint32_t> found;
+	auto add = [&found](const std::string& text, SearchField field) {
+		search_terms(text, [&](const std::string& term) {
+			found[term] |= static_cast<uint32_t>(field);
+		});
+	};
+	auto flush = [&](const pkgCache::PkgIterator& pkg) {
+		// Every end of a name term is a term too,
+		// so searching for `foo` finds `libfoo-dev`.
+		search_terms(pkg.Name(), [&](const std::string& term) {
+			for (size_t start = 0; term.size() - start >= SEARCH_MIN_TERM; start++) {
+				found[term.substr(start)] |= static_cast<uint32_t>(SearchField::Name);
+			}
+		});
+		for (const auto& term : found) {
+			postings[term.first].push_back(SearchPosting{ pkg->ID, term.second });
+		}
+		found.clear();
+	};
+
+	std::vector<std::pair<pkgCache::PkgIterator, pkgCache::DescFileIterator>> descs;
+	for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+		// Virtual packages have nothing to describe.
+		pkgCache::VerIterator ver = pkg.VersionList();
+		if (ver.end()) {
+			continue;
+		}
+
+		pkgCache::DescIterator desc = ver.TranslatedDescription();
+		if (desc.end() || desc.FileList().end()) {
+			flush(pkg);
+			continue;
+		}
+		descs.emplace_back(pkg, desc.FileList());
+	}
+
+	// Read each description file front to back.
+	std::sort(descs.begin(), descs.end(), [](const auto& a, const auto& b) {
+		if (a.second->File != b.second->File) {
+			return a.second->File < b.second->File;
+		}
+		return a.second->Offset < b.second->Offset;
+	});
+
+	pkgRecords records(cache);
+	handle_errors();
+	for (const auto& desc : descs) {
+		pkgRecords::Parser& parser = records.Lookup(desc.second);
+		add(parser.ShortDesc(), SearchField::ShortDesc);
+		add(parser.LongDesc(), SearchField::LongDesc);
+		flush(desc.first);
+	}
+
+	std::vector<const std::pair<const std::string, std::vector<SearchPosting>>*> sorted;
+	sorted.reserve(postings.size());
+	for (const auto& term : postings) {
+		sorted.push_back(&term);
+	}
+	std::sort(sorted.begin(), sorted.end(),
+	[](const auto* a, const auto* b) { return a->first < b->first; });
+
+	SearchHeader header = {};
+	memcpy(header.magic, SEARCH_MAGIC, sizeof(header.magic));
+	header.version = SEARCH_VERSION;
+	header.key = key;
+
+	std::vector<SearchTerm> terms;
+	std::vector<SearchPosting> all_postings;
+	std::string strings;
+	terms.reserve(sorted.size());
+	for (const auto* term : sorted) {
+		std::vector<SearchPosting> ids = term->second;
+		std::sort(ids.begin(), ids.end(),
+		[](const SearchPosting& a, const SearchPosting& b) { return a.pkg_id < b.pkg_id; });
+
+		terms.push_back(SearchTerm{ static_cast<uint32_t>(strings.size()),
+		static_cast<uint32_t>(term->first.size()), static_cast<uint32_t>(all_postings.size()),
+		static_cast<uint32_t>(ids.size()) });
+		strings.append(term->first);
+		all_postings.insert(all_postings.end(), ids.begin(), ids.end());
+	}
+	header.term_count = terms.size();
+	header.posting_count = all_postings.size();
+	header.strings_size = strings.size();
+
+	FileFd out;
+	if (out.Open(path, FileFd::WriteAtomic)) {
+		out.Write(&header, sizeof(header));
+		out.Write(terms.data(), terms.size() * sizeof(SearchTerm));
+		out.Write(all_postings.data(), all_postings.size() * sizeof(SearchPosting));
+		out.Write(strings.data(), strings.size());
+		out.Close();
+	}
+	handle_errors();
+}
+
+/// A search index mapped into memory.
+struct SearchIndex {
+	FileFd fd;
+	std::unique_ptr<MMap> map;
+
+	const SearchHeader* header;
+	const SearchTerm* terms;
+	const SearchPosting* postings;
+	const char* strings;
+
+	/// True if the index was out of date and had to be written.
+	bool was_rebuilt;
+
+	/// Map the index at a path. Returns false if it doesn't exist,
+	/// is for a different key, or isn't a whole index.
+	inline bool load(const std::string& path, uint64_t key) {
+		map.reset();
+		fd.Close();
+		if (!FileExists(path) || !fd.Open(path, FileFd::ReadOnly) ||
+		fd.Size() < sizeof(SearchHeader)) {
+			_error->Discard();
+			return false;
+		}
+
+		map = std::make_unique<MMap>(fd, MMap::ReadOnly);
+		if (!map->validData()) {
+			_error->Discard();
+			return false;
+		}
+
+		const char* base = static_cast<const char*>(map->Data());
+		header = reinterpret_cast<const SearchHeader*>(base);
+		if (memcmp(header->magic, SEARCH_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SEARCH_VERSION || header->key != key) {
+			return false;
+		}
+
+		uint64_t terms_size = uint64_t(header->term_count) * sizeof(SearchTerm);
+		uint64_t postings_size = uint64_t(header->posting_count) * sizeof(SearchPosting);
+		if (map->Size() != sizeof(SearchHeader) + terms_size + postings_size + header->strings_size) {
+			return false;
+		}
+		terms = reinterpret_cast<const SearchTerm*>(base + sizeof(SearchHeader));
+		postings = reinterpret_cast<const SearchPosting*>(base + sizeof(SearchHeader) + terms_size);
+		strings = base + sizeof(SearchHeader) + terms_size + postings_size;
+
+		// Check every term once so searching never reads past the map.
+		for (uint32_t i = 0; i < header->term_count; i++) {
+			const SearchTerm& term = terms[i];
+			if (uint64_t(term.string_offset) + term.string_size > header->strings_size ||
+			uint64_t(term.posting_offset) + term.posting_count > header->posting_count) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	inline APT::StringView term_at(const SearchTerm& term) const {
+		return APT::StringView(strings + term.string_offset, term.string_size);
+	}
+
+	/// Return every package with a term that starts with `prefix`,
+	/// sorted by ID, with the fields of all those terms.
+	inline std::vector<SearchPosting> find_prefix(const std::string& prefix) const {
+		const SearchTerm* end = terms + header->term_count;
+		const SearchTerm* term = std::lower_bound(terms, end, prefix,
+		[&](const SearchTerm& entry, const std::string& value) {
+			return term_at(entry).compare(value) < 0;
+		});
+
+		std::vector<SearchPosting> found;
+		for (; term != end && term->string_size >= prefix.size() &&
+		memcmp(strings + term->string_offset, prefix.data(), prefix.size()) == 0;
+		++term) {
+			found.insert(found.end(), postings + term->posting_offset,
+			postings + term->posting_offset + term->posting_count);
+		}
+
+		std::sort(found.begin(), found.end(),
+		[](const SearchPosting& a, const SearchPosting& b) { return a.pkg_id < b.pkg_id; });
+		size_t kept = 0;
+		for (const SearchPosting& posting : found) {
+			if (kept != 0 && found[kept - 1].pkg_id == posting.pkg_id) {
+				found[kept - 1].fields |= posting.fields;
+			} else {
+				found[kept++] = posting;
+			}
+		}
+		found.resize(kept);
+		return found;
+	}
+
+	/// Return every package that has all the terms in a query.
+	///
+	/// A term matches every indexed term it starts.
+	/// Packages with a term in their name come first,
+	/// then packages with a term in their short description.
+	inline rust::Vec<SearchHit> search(rust::Str query) const {
+		std::vector<std::vector<SearchPosting>> found;
+		bool missing = false;
+		search_terms(std::string(query), [&](const std::string& term) {
+			found.push_back(find_prefix(term));
+			missing |= found.back().empty();
+		});
+
+		rust::Vec<SearchHit> hits;
+		if (missing || found.empty()) {
+			return hits;
+		}
+
+		// Intersect from the rarest term, so the working set only shrinks.
+		std::sort(found.begin(), found.end(),
+		[](const std::vector<SearchPosting>& a, const std::vector<SearchPosting>& b) {
+			return a.size() < b.size();
+		});
+
+		std::vector<SearchPosting> matches = std::move(found[0]);
+		for (size_t i = 1; i < found.size() && !matches.empty(); i++) {
+			auto next = found[i].cbegin();
+			auto end = found[i].cend();
+
+			size_t kept = 0;
+			for (const SearchPosting& match : matches) {
+				next = std::lower_bound(next, end, match.pkg_id,
+				[](const SearchPosting& posting, uint32_t id) { return posting.pkg_id < id; });
+				if (next == end) {
+					break;
+				}
+				if (next->pkg_id == match.pkg_id) {
+					matches[kept++] = SearchPosting{ match.pkg_id, match.fields | next->fields };
+				}
+			}
+			matches.resize(kept);
+		}
+
+		auto rank = [](const SearchPosting& posting) {
+			if (posting.fields & static_cast<uint32_t>(SearchField::Name)) {
+				return 0;
+			}
+			return posting.fields & static_cast<uint32_t>(SearchField::ShortDesc) ? 1 : 2;
+		};
+		std::stable_sort(matches.begin(), matches.end(),
+		[&](const SearchPosting& a, const SearchPosting& b) { return rank(a) < rank(b); });
+
+		hits.reserve(matches.size());
+		for (const SearchPosting& match : matches) {
+			hits.push_back(SearchHit{ match.pkg_id, static_cast<uint8_t>(match.fields) });
+		}
+		return hits;
+	}
+
+	inline bool rebuilt() const { return was_rebuilt; }
+
+	/// The number of distinct terms in the index.
+	inline uint32_t term_count() const { return header->term_count; }
+};
+
+/// Map the search index at a path.
+///
+/// If it's missing, or the cache has changed since it was written,
+/// it's rebuilt from the records first.
+inline std::unique_ptr<SearchIndex> open_search_index(const Cache& cache, rust::Str path) {
+	pkgCache* pkg_cache = safe_get_pkg_cache(cache.ptr.get());
+	std::string file(path);
+	uint64_t key = search_index_key(*pkg_cache);
+
+	auto index = std::make_unique<SearchIndex>();
+	index->was_rebuilt = false;
+	if (index->load(file, key)) {
+		return index;
+	}
+
+	write_search_index(*pkg_cache, key, file);
+	if (!index->load(file, key)) {
+		handle_errors();
+		throw std::runtime_error("Search index '" + file + "' could not be read");
+	}
+	index->was_rebuilt = true;
+	return index;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "rust/cxx.h"
+#include <apt-pkg/debfile.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/tagfile.h>
+#include <memory>
+#include <string>
+
+#include "oma-apt/src/raw/tagfile.rs"
+
+/// A TagFile read through apt.
+///
+/// Compressed files are decompressed as they are read,
+/// only a buffer around the current section is kept in memory.
+struct TagFile {
+	FileFd fd;
+	std::unique_ptr<pkgTagFile> tag_file;
+	pkgTagSection file_section;
+
+	/// The control file of a .deb, which only has one section.
+	std::unique_ptr<debDebFile::MemControlExtract> control;
+	bool control_read;
+
+	/// The section we're on, null before the first step.
+	pkgTagSection* section;
+	/// Where that section starts, `Offset` has already moved past it.
+	unsigned long long section_offset;
+
+	/// Move to the next section. Returns false at the end of the file.
+	inline bool step() {
+		if (control) {
+			section = control_read ? nullptr : &control->Section;
+			control_read = true;
+			return section != nullptr;
+		}
+
+		section_offset = tag_file->Offset();
+		section = tag_file->Step(file_section) ? &file_section : nullptr;
+		handle_errors();
+		return section != nullptr;
+	}
+
+	inline const pkgTagSection& current() const {
+		if (!section) {
+			throw std::runtime_error("There is no section, 'step' has to return true first!");
+		}
+		return *section;
+	}
+
+	/// Return the value of a field in the current section.
+	inline rust::Str find(rust::Str key) const { return section_find(current(), key); }
+
+	/// The number of fields in the current section.
+	inline uint32_t count() const { return current().Count(); }
+
+	/// Return the key of the field at an index.
+	inline rust::Str key_at(uint32_t index) const { return section_key_at(current(), index); }
+
+	/// Return the value of the field at an index.
+	inline rust::Str value_at(uint32_t index) const {
+		return section_value_at(current(), index);
+	}
+
+	/// Return the raw text of the current section.
+	inline rust::Str section_text() const {
+		const char* start;
+		const char* stop;
+		current().GetSection(start, stop);
+		return rust::Str(start, stop - start);
+	}
+
+	/// The offset of the current section in the decompressed file.
+	inline uint64_t offset() const { return section_offset; }
+
+	TagFile() : control_read(false), section(nullptr), section_offset(0){};
+};
+
+/// Open a TagFile, the compressor is detected from the extension.
+inline std::unique_ptr<TagFile> open_tagfile(rust::Str path) {
+	auto file = std::make_unique<TagFile>();
+
+	file->fd.Open(std::string(path), FileFd::ReadOnly, FileFd::Extension);
+	handle_errors();
+
+	file->tag_file = std::make_unique<pkgTagFile>(&file->fd);
+	handle_errors();
+	return file;
+}
+
+/// Open the control file of a .deb as a TagFile.
+inline std::unique_ptr<TagFile> open_deb_control(rust::Str path) {
+	auto file = std::make_unique<TagFile>();
+
+	file->fd.Open(std::string(path), FileFd::ReadOnly);
+	handle_errors();
+
+	debDebFile deb(file->fd);
+	handle_errors();
+
+	file->control = std::make_unique<debDebFile::MemControlExtract>("control");
+	if (!file->control->Read(deb)) {
+		_error->Error("Couldn't read the control file of '%s'", std::string(path).c_str());
+	}
+	handle_errors();
+	return file;
+}
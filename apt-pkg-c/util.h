@@ -2,10 +2,18 @@
 #include "rust/cxx.h"
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/cachefile.h>
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/install-progress.h>
 #include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/string_view.h>
+#include <apt-pkg/strutl.h>
+#include <apt-pkg/tagfile.h>
 #include <apt-pkg/version.h>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
 
 //#include "oma-apt/src/package.rs"
 
@@ -57,6 +65,130 @@ inline rust::string handle_string(std::string string) {
 	return string;
 }
 
+/// Used in ID columns when there is nothing to point at,
+/// such as the current version of a package that isn't installed.
+/// This is u32::MAX on the Rust side.
+const uint32_t NONE_ID = std::numeric_limits<uint32_t>::max();
+
+/// pkgCache has no way to go from a Package ID to an iterator.
+/// Walk the cache once and build a table indexed by ID.
+inline std::vector<pkgCache::PkgIterator> pkg_id_table(pkgCache& cache) {
+	std::vector<pkgCache::PkgIterator> table(cache.Head().PackageCount);
+	for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+		table[pkg->ID] = pkg;
+	}
+	return table;
+}
+
+/// Look up a Package ID in a table from `pkg_id_table`.
+/// Throw a Result to rust if an ID isn't in the cache.
+inline pkgCache::PkgIterator pkg_from_table(
+const std::vector<pkgCache::PkgIterator>& table, uint32_t id) {
+	if (id >= table.size() || table[id].end()) {
+		throw std::runtime_error(
+		"Package ID '" + std::to_string(id) + "' is not in the cache");
+	}
+	return table[id];
+}
+
+/// Like `pkg_id_table` but for Version IDs.
+inline std::vector<pkgCache::VerIterator> ver_id_table(pkgCache& cache) {
+	std::vector<pkgCache::VerIterator> table(cache.Head().VersionCount);
+	for (pkgCache::PkgIterator pkg = cache.PkgBegin(); !pkg.end(); ++pkg) {
+		for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+			table[ver->ID] = ver;
+		}
+	}
+	return table;
+}
+
+/// Look up a Version ID in a table from `ver_id_table`.
+/// Throw a Result to rust if an ID isn't in the cache.
+inline pkgCache::VerIterator ver_from_table(
+const std::vector<pkgCache::VerIterator>& table, uint32_t id) {
+	if (id >= table.size() || table[id].end()) {
+		throw std::runtime_error(
+		"Version ID '" + std::to_string(id) + "' is not in the cache");
+	}
+	return table[id];
+}
+
+/// Return the value of a field in a section, without copying it.
+inline rust::Str section_find(const pkgTagSection& section, rust::Str key) {
+	const char* start;
+	const char* end;
+	if (!section.Find(APT::StringView(key.data(), key.size()), start, end) ||
+	start == end) {
+		throw std::runtime_error("Field Not Found");
+	}
+	return rust::Str(start, end - start);
+}
+
+/// Get the whole line of the field at an index, including the key.
+inline const char* section_line(
+const pkgTagSection& section, uint32_t index, const char*& end) {
+	if (index >= section.Count()) {
+		throw std::runtime_error("Field index out of range");
+	}
+	const char* start;
+	section.Get(start, end, index);
+
+	const char* colon = static_cast<const char*>(memchr(start, ':', end - start));
+	if (colon == nullptr) {
+		throw std::runtime_error("Field has no key");
+	}
+	return start;
+}
+
+/// Return the key of the field at an index in a section.
+inline rust::Str section_key_at(const pkgTagSection& section, uint32_t index) {
+	const char* end;
+	const char* start = section_line(section, index, end);
+	const char* colon = static_cast<const char*>(memchr(start, ':', end - start));
+	return rust::Str(start, colon - start);
+}
+
+/// Return the value of the field at an index in a section.
+inline rust::Str section_value_at(const pkgTagSection& section, uint32_t index) {
+	const char* end;
+	const char* start = section_line(section, index, end);
+	const char* value = static_cast<const char*>(memchr(start, ':', end - start)) + 1;
+
+	// Same as pkgTagSection::Find, no leading or trailing whitespace.
+	while (value < end && isspace_ascii(*value)) {
+		value++;
+	}
+	while (end > value && isspace_ascii(end[-1])) {
+		end--;
+	}
+	return rust::Str(value, end - value);
+}
+
+/// Return the versioning system, setting up the system if it isn't.
+inline pkgVersioningSystem& version_system() {
+	if (!_system) {
+		pkgInitSystem(*_config, _system);
+	}
+	return *_system->VS;
+}
+
+/// Copy versions into strings that end in a null.
+/// apt can read one past the end of a version while comparing.
+template <typename T>
+inline std::vector<std::string> version_strings(rust::Slice<T> versions) {
+	std::vector<std::string> strings;
+	strings.reserve(versions.size());
+	for (const auto& version : versions) {
+		strings.emplace_back(version.data(), version.size());
+	}
+	return strings;
+}
+
+inline int version_cmp(pkgVersioningSystem& vs, const std::string& ver1, const std::string& ver2) {
+	return vs.DoCmpVersion(
+	ver1.c_str(), ver1.c_str() + ver1.size(), ver2.c_str(), ver2.c_str() + ver2.size());
+}
+
 //////////////////////////////////
 /// End Internal Helper Functions.
 //////////////////////////////////
@@ -66,11 +198,78 @@ inline int32_t cmp_versions(rust::String ver1_rust, rust::String ver2_rust) {
 	const char* ver1 = ver1_rust.c_str();
 	const char* ver2 = ver2_rust.c_str();
 
-	if (!_system) {
-		pkgInitSystem(*_config, _system);
+	return version_system().DoCmpVersion(ver1, ver1 + strlen(ver1), ver2, ver2 + strlen(ver2));
+}
+
+/// Sort versions from lowest to highest. Equal versions keep their order.
+inline void sort_versions(rust::Slice<rust::String> versions) {
+	pkgVersioningSystem& vs = version_system();
+	std::vector<std::string> strings = version_strings(versions);
+
+	std::vector<size_t> order(strings.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(),
+	[&](size_t a, size_t b) { return version_cmp(vs, strings[a], strings[b]) < 0; });
+
+	for (size_t i = 0; i < order.size(); i++) {
+		versions[i] = strings[order[i]];
 	}
+}
 
-	return _system->VS->DoCmpVersion(ver1, ver1 + strlen(ver1), ver2, ver2 + strlen(ver2));
+/// Return the index of the highest version, the first if there are equals.
+inline size_t max_version(rust::Slice<const rust::Str> versions) {
+	if (versions.empty()) {
+		throw std::runtime_error("No versions to compare");
+	}
+	pkgVersioningSystem& vs = version_system();
+	std::vector<std::string> strings = version_strings(versions);
+
+	size_t max = 0;
+	for (size_t i = 1; i < strings.size(); i++) {
+		if (version_cmp(vs, strings[i], strings[max]) > 0) {
+			max = i;
+		}
+	}
+	return max;
+}
+
+/// Return the index of every version that satisfies `op ver`,
+/// where `op` is written like in a dependency, such as ">=".
+inline rust::Vec<size_t> filter_satisfying(
+rust::Slice<const rust::Str> versions, rust::Str op, rust::Str ver) {
+	// The same as debListParser::ConvertRelation, `<` and `>` are the old
+	// way to write `<=` and `>=`.
+	std::string op_str(op);
+	int compare_op;
+	if (op_str == "<=" || op_str == "<") {
+		compare_op = pkgCache::Dep::LessEq;
+	} else if (op_str == ">=" || op_str == ">") {
+		compare_op = pkgCache::Dep::GreaterEq;
+	} else if (op_str == "<<") {
+		compare_op = pkgCache::Dep::Less;
+	} else if (op_str == ">>") {
+		compare_op = pkgCache::Dep::Greater;
+	} else if (op_str == "=") {
+		compare_op = pkgCache::Dep::Equals;
+	} else if (op_str == "!=") {
+		compare_op = pkgCache::Dep::NotEquals;
+	} else {
+		throw std::runtime_error("Unknown version compare '" + op_str + "'");
+	}
+
+	pkgVersioningSystem& vs = version_system();
+	std::vector<std::string> strings = version_strings(versions);
+	std::string target(ver);
+
+	rust::Vec<size_t> matches;
+	for (size_t i = 0; i < strings.size(); i++) {
+		if (vs.CheckDep(strings[i].c_str(), compare_op, target.c_str())) {
+			matches.push_back(i);
+		}
+	}
+	return matches;
 }
 
 /// Return an APT-styled progress bar (`[####  ]`).
@@ -0,0 +1,61 @@
+//! Compare a full dependency traversal of the cache between the
+//! [`oma_apt::raw::package`] structs and the allocation free handles in
+//! [`oma_apt::raw::handle`].
+//!
+//! Run with `cargo bench --bench traversal`.
+use std::time::{Duration, Instant};
+
+use oma_apt::cache::Cache;
+use oma_apt::new_cache;
+use oma_apt::raw::handle::raw::{all_pkgs, dep_target_pkg, pkg_name};
+
+const RUNS: u32 = 5;
+
+/// Walk every dependency of every version with the boxed iterators.
+fn walk_boxed(cache: &Cache) -> (usize, usize) {
+	let (mut edges, mut bytes) = (0, 0);
+	for pkg in cache.raw_pkgs().unwrap() {
+		for ver in pkg.version_list().into_iter().flatten() {
+			for dep in ver.depends().into_iter().flatten() {
+				edges += 1;
+				bytes += dep.target_pkg().name().len();
+			}
+		}
+	}
+	(edges, bytes)
+}
+
+/// Walk every dependency of every version with handles.
+fn walk_handles(cache: &Cache) -> (usize, usize) {
+	let (mut edges, mut bytes) = (0, 0);
+	for pkg in all_pkgs(cache).unwrap() {
+		for ver in pkg.versions(cache).unwrap() {
+			for dep in ver.unwrap().depends(cache).unwrap() {
+				let target = dep_target_pkg(cache, dep.unwrap()).unwrap();
+				edges += 1;
+				bytes += pkg_name(cache, target).unwrap().len();
+			}
+		}
+	}
+	(edges, bytes)
+}
+
+fn bench(name: &str, cache: &Cache, walk: fn(&Cache) -> (usize, usize)) -> (usize, usize) {
+	let mut best = Duration::MAX;
+	let mut result = (0, 0);
+	for _ in 0..RUNS {
+		let start = Instant::now();
+		result = walk(cache);
+		best = best.min(start.elapsed());
+	}
+	println!("{name:>8}: {best:?} ({} edges)", result.0);
+	result
+}
+
+fn main() {
+	let cache = new_cache!().unwrap();
+
+	let boxed = bench("boxed", &cache, walk_boxed);
+	let handles = bench("handles", &cache, walk_handles);
+	assert_eq!(boxed, handles);
+}
@@ -8,6 +8,10 @@ fn main() {
 		"src/raw/records.rs",
 		"src/raw/depcache.rs",
 		"src/raw/pkgmanager.rs",
+		"src/raw/handle.rs",
+		"src/raw/depgraph.rs",
+		"src/raw/tagfile.rs",
+		"src/raw/search.rs",
 	];
 
 	cxx_build::bridges(source_files)
@@ -24,6 +28,10 @@ fn main() {
 	println!("cargo:rerun-if-changed=src/raw/depcache.rs");
 	println!("cargo:rerun-if-changed=src/raw/package.rs");
 	println!("cargo:rerun-if-changed=src/raw/pkgmanager.rs");
+	println!("cargo:rerun-if-changed=src/raw/handle.rs");
+	println!("cargo:rerun-if-changed=src/raw/depgraph.rs");
+	println!("cargo:rerun-if-changed=src/raw/tagfile.rs");
+	println!("cargo:rerun-if-changed=src/raw/search.rs");
 
 	println!("cargo:rerun-if-changed=apt-pkg-c/progress.cc");
 
@@ -35,4 +43,8 @@ fn main() {
 	println!("cargo:rerun-if-changed=apt-pkg-c/depcache.h");
 	println!("cargo:rerun-if-changed=apt-pkg-c/package.h");
 	println!("cargo:rerun-if-changed=apt-pkg-c/pkgmanager.h");
+	println!("cargo:rerun-if-changed=apt-pkg-c/handle.h");
+	println!("cargo:rerun-if-changed=apt-pkg-c/depgraph.h");
+	println!("cargo:rerun-if-changed=apt-pkg-c/tagfile.h");
+	println!("cargo:rerun-if-changed=apt-pkg-c/search.h");
 }
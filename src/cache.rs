@@ -1,24 +1,37 @@
 //! Contains Cache related structs.
 
+use std::cell::RefCell;
 use std::error::Error;
 use std::fs;
 use std::ops::Deref;
 use std::path::Path;
+use std::rc::Rc;
+use std::time::Instant;
 
 use cxx::{Exception, UniquePtr};
 use once_cell::unsync::OnceCell;
 
 use crate::config::{init_config_system, Config};
-use crate::depcache::DepCache;
+use crate::depcache::{DepCache, Simulation};
 use crate::package::Package;
 use crate::raw::cache::raw;
+use crate::raw::cache::raw::{
+	FilterFlag, OpenProfile, PackageFilter, PackageSnapshot, PkgTable, PolicyTable,
+};
+use crate::raw::depgraph::raw::{
+	create_dep_graph, dep_closure, ClosureQuery, ClosureSets, DepGraph,
+};
+use crate::raw::handle::raw::{all_pkgs, ver_id, ver_str};
 use crate::raw::package::RawPackage;
 use crate::raw::pkgmanager::raw::{
-	create_pkgmanager, create_problem_resolver, PackageManager, ProblemResolver,
+	create_pkgmanager, create_problem_resolver, PackageManager, ProblemResolver, ResolverStats,
+};
+use crate::raw::progress::{
+	AcquireProgress, Budget, BudgetError, InstallProgress, OperationProgress,
 };
-use crate::raw::progress::{AcquireProgress, InstallProgress, OperationProgress};
 use crate::raw::records::raw::Records;
-use crate::util::{apt_lock, apt_unlock, apt_unlock_inner};
+use crate::raw::search::raw::{open_search_index, SearchIndex};
+use crate::util::{apt_lock, apt_unlock, apt_unlock_inner, push_version_key};
 
 type RawRecords = UniquePtr<Records>;
 type RawPkgManager = UniquePtr<PackageManager>;
@@ -157,6 +170,37 @@ impl PackageSort {
 		self.auto_removable = Sort::Reverse;
 		self
 	}
+
+	/// Compile the sort into a [`PackageFilter`] that can be checked in C++.
+	pub fn filter(&self) -> PackageFilter {
+		let mut filter = PackageFilter {
+			require: 0,
+			exclude: 0,
+			names: self.names,
+		};
+
+		// Virtual packages work backwards from the rest.
+		// Disabled means only packages with versions are included.
+		match self.virtual_pkgs {
+			Sort::Enable => {},
+			Sort::Disable => filter.require |= FilterFlag::HasVersions.repr,
+			Sort::Reverse => filter.exclude |= FilterFlag::HasVersions.repr,
+		}
+
+		for (sort, flag) in [
+			(&self.upgradable, FilterFlag::Upgradable),
+			(&self.installed, FilterFlag::Installed),
+			(&self.auto_installed, FilterFlag::AutoInstalled),
+			(&self.auto_removable, FilterFlag::AutoRemovable),
+		] {
+			match sort {
+				Sort::Disable => {},
+				Sort::Enable => filter.require |= flag.repr,
+				Sort::Reverse => filter.exclude |= flag.repr,
+			}
+		}
+		filter
+	}
 }
 
 /// The main struct for accessing any and all `apt` data.
@@ -166,6 +210,12 @@ pub struct Cache {
 	records: OnceCell<RawRecords>,
 	pkgmanager: OnceCell<RawPkgManager>,
 	problem_resolver: OnceCell<RawProblemResolver>,
+	dep_graph: OnceCell<DepGraph>,
+	pkg_table: OnceCell<UniquePtr<PkgTable>>,
+	name_index: OnceCell<NameIndex>,
+	version_keys: OnceCell<Option<VersionKeys>>,
+	policy_table: RefCell<Option<(u64, Rc<PolicyTable>)>>,
+	open_profile: Option<OpenProfile>,
 	local_debs: Vec<String>,
 }
 
@@ -184,14 +234,77 @@ impl Cache {
 		let deb_pkgs: Vec<_> = deb_files.iter().map(|d| d.to_string()).collect();
 
 		init_config_system();
-		Ok(Cache {
-			cache: raw::create_cache(&deb_pkgs)?,
+		Ok(Self::from_raw(raw::create_cache(&deb_pkgs)?, deb_pkgs))
+	}
+
+	/// Like [`Cache::new`], but open everything right away and time it.
+	///
+	/// The profile is kept with the cache, see [`Cache::open_profile`].
+	///
+	/// # Example:
+	///
+	/// ```
+	/// use oma_apt::cache::Cache;
+	///
+	/// let debs: Vec<String> = Vec::new();
+	/// let cache = Cache::new_profiled(&debs).unwrap();
+	///
+	/// println!("{}", cache.open_profile().unwrap());
+	/// ```
+	pub fn new_profiled<T: ToString>(deb_files: &[T]) -> Result<Cache, Exception> {
+		let deb_pkgs: Vec<_> = deb_files.iter().map(|d| d.to_string()).collect();
+
+		let start = Instant::now();
+		init_config_system();
+		let raw_cache = raw::create_cache(&deb_pkgs)?;
+		let create = start.elapsed();
+
+		let mut profile = raw_cache.open_profile()?;
+		profile.create_micros = create.as_micros() as u64;
+
+		let mut cache = Self::from_raw(raw_cache, deb_pkgs);
+
+		// The rest of the DepCache is made on the Rust side.
+		let start = Instant::now();
+		cache.depcache();
+		profile.depcache_micros += start.elapsed().as_micros() as u64;
+
+		let start = Instant::now();
+		cache.records();
+		profile.records_micros = start.elapsed().as_micros() as u64;
+
+		cache.open_profile = Some(profile);
+		Ok(cache)
+	}
+
+	fn from_raw(cache: raw::Cache, local_debs: Vec<String>) -> Cache {
+		Cache {
+			cache,
 			depcache: OnceCell::new(),
 			records: OnceCell::new(),
 			pkgmanager: OnceCell::new(),
 			problem_resolver: OnceCell::new(),
-			local_debs: deb_files.iter().map(|d| d.to_string()).collect(),
-		})
+			dep_graph: OnceCell::new(),
+			pkg_table: OnceCell::new(),
+			name_index: OnceCell::new(),
+			version_keys: OnceCell::new(),
+			policy_table: RefCell::new(None),
+			open_profile: None,
+			local_debs,
+		}
+	}
+
+	/// The timing profile of opening the cache,
+	/// if it was opened with [`Cache::new_profiled`].
+	pub fn open_profile(&self) -> Option<&OpenProfile> { self.open_profile.as_ref() }
+
+	/// Return the packages for a list of IDs, in the same order.
+	///
+	/// The [`PkgTable`] is built on first use and kept with the cache.
+	pub fn pkgs_by_id(&self, ids: &[u32]) -> Result<Vec<RawPackage>, Exception> {
+		self.pkg_table
+			.get_or_try_init(|| self.cache.create_pkg_table())?
+			.pkgs_by_id(ids)
 	}
 
 	/// Internal Method for generating the package list.
@@ -203,6 +316,14 @@ impl Cache {
 			.get_or_init(|| DepCache::new(self.create_depcache()))
 	}
 
+	/// Create a [`Simulation`], a DepCache of its own over this cache.
+	///
+	/// Simulations borrow the cache, see [`Simulation`].
+	pub fn simulation(&self) -> Result<Simulation<'_>, Exception> {
+		// Safety: The Simulation borrows the cache, so it can't outlive it.
+		Ok(Simulation::new(unsafe { self.cache.create_simulation()? }))
+	}
+
 	/// Get the PkgRecords
 	pub fn records(&self) -> &RawRecords { self.records.get_or_init(|| self.create_records()) }
 
@@ -218,121 +339,91 @@ impl Cache {
 			.get_or_init(|| create_problem_resolver(&self.cache))
 	}
 
-	/// Iterate through the packages in a random order
-	pub fn iter(&self) -> CacheIter {
-		CacheIter {
-			pkgs: self.begin().unwrap(),
-			cache: self,
-		}
+	/// Get the dependency graph of every version in the cache.
+	///
+	/// The graph is built on first use, after that it is free.
+	pub fn dep_graph(&self) -> Result<&DepGraph, Exception> {
+		self.dep_graph
+			.get_or_try_init(|| create_dep_graph(&self.cache))
 	}
 
-	/// An iterator of packages in the cache.
-	pub fn packages(&self, sort: &PackageSort) -> Result<impl Iterator<Item = Package>, Exception> {
-		let mut pkg_list = vec![];
-		for pkg in self.raw_pkgs()? {
-			match sort.virtual_pkgs {
-				// Virtual packages are enabled, include them.
-				// This works differently than the rest. I should probably change defaults.
-				Sort::Enable => {},
-				// If disabled and pkg has no versions, exclude
-				Sort::Disable => {
-					if !pkg.has_versions() {
-						continue;
-					}
-				},
-				// If reverse and the package has versions, exclude
-				// This section is for if you only want virtual packages
-				Sort::Reverse => {
-					if pkg.has_versions() {
-						continue;
-					}
-				},
+	/// Get the priority of every version and the candidate of every package.
+	///
+	/// The table is kept until [`DepCache::generation`] changes, which is
+	/// when a candidate is set with [`DepCache::set_candidate_version`],
+	/// the DepCache is reset with [`DepCache::init`] or
+	/// [`DepCache::clear_marked`], or a checkpoint is restored.
+	///
+	/// Pins are read from the preferences files once, when the policy of
+	/// the cache is built, and nothing in this crate changes them after
+	/// that. Changing the pin config or preferences files needs a new
+	/// [`Cache`], which starts with no table.
+	pub fn policy_table(&self) -> Result<Rc<PolicyTable>, Exception> {
+		let generation = self.depcache().generation();
+		if let Some((built, table)) = self.policy_table.borrow().as_ref() {
+			if *built == generation {
+				return Ok(table.clone());
 			}
+		}
 
-			match sort.upgradable {
-				// Virtual packages are enabled, include them.
-				Sort::Disable => {},
-				// If disabled and pkg has no versions, exclude
-				Sort::Enable => {
-					// TODO: These are probably wrong.
-					// If the package isn't installed, then it can not be upgradable
-					if !pkg.is_installed() || !self.depcache().is_upgradable(&pkg) {
-						continue;
-					}
-				},
-				// If reverse and the package has versions, exclude
-				// This section is for if you only want virtual packages
-				Sort::Reverse => {
-					if pkg.is_installed() && self.depcache().is_upgradable(&pkg) {
-						continue;
-					}
-				},
-			}
+		let table = Rc::new(self.cache.policy_table()?);
+		*self.policy_table.borrow_mut() = Some((generation, table.clone()));
+		Ok(table)
+	}
 
-			match sort.installed {
-				// Installed Package is Disabled, so we keep them
-				Sort::Disable => {},
-				Sort::Enable => {
-					if !pkg.is_installed() {
-						continue;
-					}
-				},
-				// Only include installed packages.
-				Sort::Reverse => {
-					if pkg.is_installed() {
-						continue;
-					}
-				},
-			}
+	/// Walk the transitive closure of each root Package ID.
+	///
+	/// Roots are walked in parallel over the [`DepGraph`],
+	/// so after the first call nothing is read from the cache.
+	/// See [`ClosureQuery`] for what is followed.
+	pub fn closure(&self, roots: &[u32], query: &ClosureQuery) -> Result<ClosureSets, Exception> {
+		let graph = self.dep_graph()?;
+		if !query.candidates {
+			return dep_closure(graph, &[], roots, query);
+		}
+		dep_closure(graph, &self.policy_table()?.candidates, roots, query)
+	}
 
-			match sort.auto_installed {
-				// Installed Package is Disabled, so we keep them
-				Sort::Disable => {},
-				Sort::Enable => {
-					if !self.depcache().is_auto_installed(&pkg) {
-						continue;
-					}
-				},
-				// Only include installed packages.
-				Sort::Reverse => {
-					if self.depcache().is_auto_installed(&pkg) {
-						continue;
-					}
-				},
-			}
+	/// Open the search index at `path`.
+	///
+	/// The index is written first if it doesn't exist, or if the package
+	/// lists or description languages have changed since it was written.
+	/// After that, searches don't read any records.
+	pub fn search_index(&self, path: &Path) -> Result<UniquePtr<SearchIndex>, Exception> {
+		open_search_index(&self.cache, &path.to_string_lossy())
+	}
 
-			match sort.auto_removable {
-				// auto_removable is Disabled, so we keep them
-				Sort::Disable => {},
-				// If the package is not auto removable skip it.
-				Sort::Enable => {
-					// If the Package is installed or marked install then it cannot be Garbage.
-					if (!pkg.is_installed() || !self.depcache().marked_install(&pkg))
-						|| self.depcache().is_garbage(&pkg)
-					{
-						continue;
-					}
-				},
-				// Only include installed packages.
-				// If the package is auto removable skip it.
-				Sort::Reverse => {
-					if (pkg.is_installed() || self.depcache().marked_install(&pkg))
-						&& self.depcache().is_garbage(&pkg)
-					{
-						continue;
-					}
-				},
-			}
+	/// Get every package that has all the words in `query`,
+	/// name matches first.
+	pub fn search(
+		&self,
+		index: &SearchIndex,
+		query: &str,
+	) -> Result<impl Iterator<Item = Package>, Exception> {
+		let ids: Vec<u32> = index.search(query).iter().map(|hit| hit.pkg_id).collect();
+
+		Ok(self
+			.pkgs_by_id(&ids)?
+			.into_iter()
+			.map(|pkg| Package::new(self, pkg)))
+	}
 
-			// If this is reached we're clear to include the package.
-			pkg_list.push(pkg);
+	/// Iterate through the packages in a random order
+	pub fn iter(&self) -> CacheIter {
+		CacheIter {
+			pkgs: self.begin().unwrap(),
+			cache: self,
 		}
+	}
 
-		if sort.names {
-			pkg_list.sort_by_cached_key(|pkg| pkg.name().to_string());
-		}
+	/// An iterator of packages in the cache.
+	pub fn packages(&self, sort: &PackageSort) -> Result<impl Iterator<Item = Package>, Exception> {
+		let ids = self.filter_pkgs(&sort.filter())?;
 
-		Ok(pkg_list.into_iter().map(|pkg| Package::new(self, pkg)))
+		Ok(self
+			.pkgs_by_id(&ids)?
+			.into_iter()
+			.map(|pkg| Package::new(self, pkg)))
 	}
 
 	/// Updates the package cache and returns a Result
@@ -386,6 +477,26 @@ impl Cache {
 		}
 	}
 
+	/// Like [`Cache::upgrade`], but within a budget, see [`Budget`].
+	///
+	/// Returns [`BudgetError::Exceeded`] if it ran out,
+	/// the marks are then as they were before the call.
+	pub fn upgrade_budgeted(
+		&self,
+		upgrade_type: &Upgrade,
+		budget: &Budget,
+	) -> Result<(), BudgetError> {
+		let (allow_remove, allow_new) = match upgrade_type {
+			Upgrade::FullUpgrade => (true, true),
+			Upgrade::SafeUpgrade => (false, false),
+			Upgrade::Upgrade => (false, true),
+		};
+		self.depcache()
+			.upgrade_budgeted(allow_remove, allow_new, &mut budget.new_box())?
+			.finished()?;
+		Ok(())
+	}
+
 	/// Resolve dependencies with the changes marked on all packages. This marks
 	/// additional packages for installation/removal to satisfy the dependency
 	/// chain.
@@ -408,6 +519,29 @@ impl Cache {
 			.resolve(fix_broken, &mut NoOpProgress::new_box())
 	}
 
+	/// Like [`Cache::resolve`], but within a budget, see [`Budget`].
+	///
+	/// Returns [`BudgetError::Exceeded`] if it ran out,
+	/// the marks are then as they were before the call.
+	pub fn resolve_budgeted(&self, fix_broken: bool, budget: &Budget) -> Result<(), BudgetError> {
+		self.resolver()
+			.resolve_budgeted(fix_broken, &mut budget.new_box())?
+			.finished()?;
+		Ok(())
+	}
+
+	/// Like [`Cache::resolve`], but measure the solve.
+	///
+	/// Returns the wall time, the broken packages before and after, and how
+	/// many packages the solve kept, removed and installed.
+	///
+	/// A failed solve still returns its stats, with the errors in
+	/// [`ResolverStats::error`].
+	pub fn resolve_with_stats(&self, fix_broken: bool) -> ResolverStats {
+		self.resolver()
+			.resolve_with_stats(fix_broken, &mut NoOpProgress::new_box())
+	}
+
 	/// Autoinstall every broken package and run the problem resolver
 	/// Returns false if the problem resolver fails.
 	///
@@ -426,6 +560,16 @@ impl Cache {
 	/// ```
 	pub fn fix_broken(&self) -> bool { self.depcache().fix_broken() }
 
+	/// Like [`Cache::fix_broken`], but within a budget, see [`Budget`].
+	///
+	/// Returns [`BudgetError::Exceeded`] if it ran out,
+	/// the marks are then as they were before the call.
+	pub fn fix_broken_budgeted(&self, budget: &Budget) -> Result<bool, BudgetError> {
+		self.depcache()
+			.fix_broken_budgeted(&mut budget.new_box())
+			.finished()
+	}
+
 	/// Fetch any archives needed to complete the transaction.
 	///
 	/// # Returns:
@@ -585,6 +729,55 @@ impl Cache {
 		Some(Package::new(self, self.find_pkg(name)?))
 	}
 
+	/// Get many packages in one call.
+	///
+	/// Names are the same as [`Cache::get`],
+	/// and the packages are in the same order as the names.
+	pub fn get_many(&self, names: &[&str]) -> Result<Vec<Option<Package>>, Exception> {
+		Ok(self
+			.find_pkgs(names)?
+			.into_iter()
+			.map(|pkg| match pkg.end() {
+				true => None,
+				false => Some(Package::new(self, pkg)),
+			})
+			.collect())
+	}
+
+	/// Get the index of package names.
+	///
+	/// The index is built on first use, after that it is free.
+	pub fn name_index(&self) -> Result<&NameIndex, Exception> {
+		self.name_index
+			.get_or_try_init(|| Ok(NameIndex::new(self.snapshot()?)))
+	}
+
+	/// Get the sort key of a version by ID.
+	/// See [`crate::util::version_key`].
+	///
+	/// Keys for every version are made on first use, after that this is
+	/// free. Returns `None` if the ID is not in the cache,
+	/// or if the keys couldn't be made. A failure is kept as well,
+	/// so the keys are only ever made once.
+	pub fn version_key(&self, ver_id: u32) -> Option<&[u8]> {
+		self.version_keys
+			.get_or_init(|| VersionKeys::new(&self.cache).ok())
+			.as_ref()?
+			.get(ver_id)
+	}
+
+	/// Get every package whose name matches a glob such as `python3-*`.
+	///
+	/// See [`NameIndex::glob`].
+	pub fn glob(&self, pattern: &str) -> Result<impl Iterator<Item = Package>, Exception> {
+		let ids = self.name_index()?.glob(pattern);
+
+		Ok(self
+			.pkgs_by_id(&ids)?
+			.into_iter()
+			.map(|pkg| Package::new(self, pkg)))
+	}
+
 	/// An iterator over the packages
 	/// that will be altered when `cache.commit()` is called.
 	///
@@ -592,19 +785,7 @@ impl Cache {
 	/// * [`true`] = Packages will be in alphabetical order
 	/// * [`false`] = Packages will not be sorted by name
 	pub fn get_changes(&self, sort_name: bool) -> Result<impl Iterator<Item = Package>, Exception> {
-		let mut changed = Vec::new();
-		let depcache = self.depcache();
-
-		for pkg in self.raw_pkgs()? {
-			if depcache.marked_install(&pkg)
-				|| depcache.marked_delete(&pkg)
-				|| depcache.marked_upgrade(&pkg)
-				|| depcache.marked_downgrade(&pkg)
-				|| depcache.marked_reinstall(&pkg)
-			{
-				changed.push(pkg);
-			}
-		}
+		let mut changed = self.depcache().changed_packages();
 
 		if sort_name {
 			// Sort by cached key seems to be the fastest for what we're doing.
@@ -618,6 +799,158 @@ impl Cache {
 	}
 }
 
+/// Every package name in the cache, sorted so that names can be found by
+/// exact name, prefix or glob in logarithmic time.
+///
+/// Lookups return Package IDs. Names may be qualified with an architecture,
+/// such as `apt:amd64`.
+pub struct NameIndex {
+	snapshot: PackageSnapshot,
+	/// Rows of the snapshot sorted by name, then arch.
+	sorted: Vec<u32>,
+}
+
+impl NameIndex {
+	fn new(snapshot: PackageSnapshot) -> NameIndex {
+		let mut sorted: Vec<u32> = (0..snapshot.len() as u32).collect();
+		sorted.sort_unstable_by(|a, b| {
+			let (a, b) = (*a as usize, *b as usize);
+			(snapshot.name(a), snapshot.arch(a)).cmp(&(snapshot.name(b), snapshot.arch(b)))
+		});
+		NameIndex { snapshot, sorted }
+	}
+
+	fn name(&self, index: usize) -> &str { self.snapshot.name(self.sorted[index] as usize) }
+
+	fn arch(&self, index: usize) -> &str { self.snapshot.arch(self.sorted[index] as usize) }
+
+	/// The sorted positions whose name starts with a prefix.
+	fn prefix_range(&self, prefix: &str) -> std::ops::Range<usize> {
+		let start = self
+			.sorted
+			.partition_point(|row| self.snapshot.name(*row as usize) < prefix);
+		let len = self.sorted[start..]
+			.partition_point(|row| self.snapshot.name(*row as usize).starts_with(prefix));
+		start..start + len
+	}
+
+	/// Package IDs of the positions in a range, filtered by name and arch.
+	fn ids(
+		&self,
+		range: std::ops::Range<usize>,
+		arch: Option<&str>,
+		matches: impl Fn(&str) -> bool,
+	) -> Vec<u32> {
+		range
+			.filter(|index| arch.map_or(true, |arch| self.arch(*index) == arch))
+			.filter(|index| matches(self.name(*index)))
+			.map(|index| self.snapshot.ids[self.sorted[index] as usize])
+			.collect()
+	}
+
+	/// Split an arch qualified name.
+	fn split_arch(name: &str) -> (&str, Option<&str>) {
+		match name.rsplit_once(':') {
+			Some((name, arch)) => (name, Some(arch)),
+			None => (name, None),
+		}
+	}
+
+	/// Every package with this name, for every architecture unless qualified.
+	pub fn find(&self, name: &str) -> Vec<u32> {
+		let (name, arch) = Self::split_arch(name);
+		self.ids(self.prefix_range(name), arch, |found| found == name)
+	}
+
+	/// Every package whose name starts with `prefix`.
+	pub fn prefix(&self, prefix: &str) -> Vec<u32> {
+		let (prefix, arch) = Self::split_arch(prefix);
+		self.ids(self.prefix_range(prefix), arch, |_| true)
+	}
+
+	/// Every package whose name matches a glob. `*` matches anything,
+	/// `?` matches a single character.
+	///
+	/// Only names that start with the text before the first wildcard are
+	/// checked, so `python3-*` doesn't look at the whole cache.
+	pub fn glob(&self, pattern: &str) -> Vec<u32> {
+		let (pattern, arch) = Self::split_arch(pattern);
+		let literal = pattern
+			.find(|c| c == '*' || c == '?')
+			.map_or(pattern, |wildcard| &pattern[..wildcard]);
+
+		self.ids(self.prefix_range(literal), arch, |name| {
+			glob_match(pattern.as_bytes(), name.as_bytes())
+		})
+	}
+}
+
+/// The sort key of every version, indexed by Version ID.
+struct VersionKeys {
+	/// Offsets into `keys`. The key of ID `i` is `offsets[i]..offsets[i + 1]`.
+	offsets: Vec<u32>,
+	keys: Vec<u8>,
+}
+
+impl VersionKeys {
+	fn new(cache: &raw::Cache) -> Result<VersionKeys, Exception> {
+		let mut versions = vec![];
+		for pkg in all_pkgs(cache)? {
+			for ver in pkg.versions(cache)? {
+				let ver = ver?;
+				versions.push((ver_id(cache, ver)?, ver_str(cache, ver)?));
+			}
+		}
+		versions.sort_unstable_by_key(|(id, _)| *id);
+
+		let mut offsets = Vec::with_capacity(versions.len() + 1);
+		let mut keys = Vec::with_capacity(versions.len() * 16);
+		for (id, version) in versions {
+			// IDs are dense, but don't trust it.
+			while offsets.len() <= id as usize {
+				offsets.push(keys.len() as u32);
+			}
+			push_version_key(version, &mut keys);
+		}
+		offsets.push(keys.len() as u32);
+		Ok(VersionKeys { offsets, keys })
+	}
+
+	fn get(&self, ver_id: u32) -> Option<&[u8]> {
+		let range = self.offsets.get(ver_id as usize..ver_id as usize + 2)?;
+		Some(&self.keys[range[0] as usize..range[1] as usize])
+	}
+}
+
+/// Match `*` and `?` wildcards against a name.
+fn glob_match(pattern: &[u8], name: &[u8]) -> bool {
+	let (mut p, mut n) = (0, 0);
+	// Where to go back to if what follows the last `*` doesn't match.
+	let mut star: Option<(usize, usize)> = None;
+
+	while n < name.len() {
+		match pattern.get(p) {
+			Some(b'*') => {
+				star = Some((p, n));
+				p += 1;
+			},
+			Some(c) if *c == b'?' || *c == name[n] => {
+				p += 1;
+				n += 1;
+			},
+			_ => match star {
+				Some((star_p, star_n)) => {
+					p = star_p + 1;
+					n = star_n + 1;
+					star = Some((star_p, star_n + 1));
+				},
+				None => return false,
+			},
+		}
+	}
+	pattern[p..].iter().all(|c| *c == b'*')
+}
+
 /// Iterator Implementation for the Cache.
 pub struct CacheIter<'a> {
 	pkgs: RawPackage,
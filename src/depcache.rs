@@ -1,19 +1,56 @@
+use std::cell::Cell;
+use std::marker::PhantomData;
 use std::ops::Deref;
 
-use cxx::Exception;
+use cxx::{Exception, UniquePtr};
 
 use crate::raw::depcache::raw;
-use crate::raw::progress::NoOpProgress;
+use crate::raw::depcache::raw::DepCacheCheckpoint;
+use crate::raw::package::RawVersion;
+use crate::raw::progress::{NoOpProgress, OperationProgress};
 use crate::util::DiskSpace;
 
 type RawDepCache = raw::DepCache;
 
 pub struct DepCache {
 	ptr: RawDepCache,
+	/// Bumped every time candidates can change,
+	/// so anything built from them knows when it's stale.
+	generation: Cell<u64>,
 }
 
 impl DepCache {
-	pub fn new(ptr: RawDepCache) -> DepCache { DepCache { ptr } }
+	pub fn new(ptr: RawDepCache) -> DepCache {
+		DepCache {
+			ptr,
+			generation: Cell::new(0),
+		}
+	}
+
+	/// How many times candidates could have changed.
+	pub fn generation(&self) -> u64 { self.generation.get() }
+
+	/// Reset the DepCache. Candidates go back to what the policy picks.
+	pub fn init(&self, callback: &mut Box<dyn OperationProgress>) -> Result<(), Exception> {
+		self.generation.set(self.generation.get() + 1);
+		self.ptr.init(callback)
+	}
+
+	/// Put back the marks from a checkpoint. Nothing is recalculated.
+	///
+	/// Returns an error if the checkpoint is from a different cache.
+	pub fn restore(&self, checkpoint: &DepCacheCheckpoint) -> Result<(), Exception> {
+		self.ptr.restore(checkpoint)?;
+		// Candidates are part of the marks.
+		self.generation.set(self.generation.get() + 1);
+		Ok(())
+	}
+
+	/// Set a version to be the candidate of it's package.
+	pub fn set_candidate_version(&self, ver: &RawVersion) {
+		self.generation.set(self.generation.get() + 1);
+		self.ptr.set_candidate_version(ver)
+	}
 
 	/// Clear any marked changes in the DepCache.
 	pub fn clear_marked(&self) -> Result<(), Exception> {
@@ -40,3 +77,59 @@ impl Deref for DepCache {
 	#[inline]
 	fn deref(&self) -> &RawDepCache { &self.ptr }
 }
+
+/// A DepCache of its own over the cache it came from,
+/// to try out marks without changing the real one.
+///
+/// Simulations share the cache and policy, which are only read, so many
+/// install sets can be kept side by side. Reuse a simulation with
+/// [`raw::Simulation::reset`], making one reads the whole cache.
+///
+/// Simulations stay on the thread that made them. apt reads the global
+/// configuration while marking and resolving, and the configuration can be
+/// written from any thread at any time.
+///
+/// ```
+/// use oma_apt::new_cache;
+///
+/// let cache = new_cache!().unwrap();
+/// let ids = [cache.get("apt").unwrap().id(), cache.get("dpkg").unwrap().id()];
+///
+/// let sims: Vec<_> = ids.iter().map(|_| cache.simulation().unwrap()).collect();
+/// for (sim, id) in sims.iter().zip(ids) {
+/// 	sim.mark_delete(id, false).unwrap();
+/// 	sim.resolve(false).ok();
+/// 	println!("{} {:?}", sim.delete_count(), sim.disk_space());
+/// }
+/// ```
+pub struct Simulation<'a> {
+	ptr: UniquePtr<raw::Simulation>,
+	/// Simulations point into the cache, but don't need the rest of it.
+	cache: PhantomData<&'a ()>,
+}
+
+impl<'a> Simulation<'a> {
+	/// The caller picks `'a`, it must not outlive the cache of `ptr`.
+	pub(crate) fn new(ptr: UniquePtr<raw::Simulation>) -> Simulation<'a> {
+		Simulation {
+			ptr,
+			cache: PhantomData,
+		}
+	}
+
+	/// The amount of space required for the marks.
+	pub fn disk_space(&self) -> DiskSpace {
+		let size = self.ptr.disk_size();
+		if size < 0 {
+			return DiskSpace::Free(-size as u64);
+		}
+		DiskSpace::Require(size as u64)
+	}
+}
+
+impl<'a> Deref for Simulation<'a> {
+	type Target = raw::Simulation;
+
+	#[inline]
+	fn deref(&self) -> &raw::Simulation { &self.ptr }
+}
@@ -7,10 +7,12 @@ use std::fmt::Debug;
 use std::hash::{Hash, Hasher};
 use std::ops::Deref;
 
+use cxx::SharedPtr;
 use once_cell::unsync::OnceCell;
 
 use crate::cache::Cache;
 use crate::raw::package::{RawDependency, RawPackage, RawPackageFile, RawProvider, RawVersion};
+use crate::raw::records::raw::RecordEntry;
 use crate::util::cmp_versions;
 
 pub struct Package<'a> {
@@ -366,16 +368,27 @@ impl<'a> Version<'a> {
 	/// Get the translated long description
 	pub fn description(&self) -> Option<String> {
 		if let Some(desc_file) = self.description_files()?.next() {
-			self.cache.records().desc_file_lookup(&desc_file);
+			self.cache.records().desc_file_lookup(&desc_file).ok()?;
 			return self.cache.records().long_desc().ok();
 		}
 		None
 	}
 
+	/// The sort key of the version, cached in the [`Cache`].
+	///
+	/// Keys compare as bytes in the same order as the versions.
+	/// `None` if the keys couldn't be made, see [`Cache::version_key`]
+	/// and [`crate::util::version_key`].
+	///
+	/// The first call makes keys for every version in the cache, so this is
+	/// for comparing many versions. `==` and `<` compare two versions
+	/// directly.
+	pub fn sort_key(&self) -> Option<&'a [u8]> { self.cache.version_key(self.id()) }
+
 	/// Get the translated short description
 	pub fn summary(&self) -> Option<String> {
 		if let Some(desc_file) = self.description_files()?.next() {
-			self.cache.records().desc_file_lookup(&desc_file);
+			self.cache.records().desc_file_lookup(&desc_file).ok()?;
 			return self.cache.records().short_desc().ok();
 		}
 		None
@@ -401,17 +414,46 @@ impl<'a> Version<'a> {
 	/// ```
 	pub fn get_record<T: ToString + ?Sized>(&self, field: &T) -> Option<String> {
 		if let Some(ver_file) = self.version_files()?.next() {
-			self.cache.records().ver_file_lookup(&ver_file);
+			self.cache.records().ver_file_lookup(&ver_file).ok()?;
 			return self.cache.records().get_field(field.to_string()).ok();
 		}
 		None
 	}
 
+	/// Get the record of the version.
+	///
+	/// The record is copied once when it isn't cached yet,
+	/// fields can then be borrowed from it without copying them again.
+	///
+	/// ```
+	/// use oma_apt::new_cache;
+	/// use oma_apt::records::RecordField;
+	///
+	/// let cache = new_cache!().unwrap();
+	/// let cand = cache.get("apt").unwrap().candidate().unwrap();
+	/// let record = cand.record().unwrap();
+	///
+	/// println!("{}", record.field(RecordField::Maintainer).unwrap());
+	/// for (key, value) in record.fields() {
+	///     println!("{key}: {value}");
+	/// }
+	/// ```
+	pub fn record(&self) -> Option<SharedPtr<RecordEntry>> {
+		let ver_file = self.version_files()?.next()?;
+		self.cache.records().ver_record(&ver_file).ok()
+	}
+
+	/// Get the translated description record of the version.
+	pub fn description_record(&self) -> Option<SharedPtr<RecordEntry>> {
+		let desc_file = self.description_files()?.next()?;
+		self.cache.records().desc_record(&desc_file).ok()
+	}
+
 	/// Get the hash specified. If there isn't one returns None
 	/// `version.hash("md5sum")`
 	pub fn hash<T: ToString + ?Sized>(&self, hash_type: &T) -> Option<String> {
 		if let Some(ver_file) = self.version_files()?.next() {
-			self.cache.records().ver_file_lookup(&ver_file);
+			self.cache.records().ver_file_lookup(&ver_file).ok()?;
 			return self.cache.records().hash_find(hash_type.to_string()).ok();
 		}
 		None
@@ -432,7 +474,7 @@ impl<'a> Version<'a> {
 			self.cache.find_index(&mut pkg_file);
 			let ver_file = self.version_files()?.next()?;
 
-			self.cache.records().ver_file_lookup(&ver_file);
+			self.cache.records().ver_file_lookup(&ver_file).ok()?;
 
 			if let Ok(uri) = self.cache.records().ver_uri(&pkg_file) {
 				// Should match this from the configurations. Hardcoding is okay for now.
@@ -545,6 +587,22 @@ impl From<u8> for DepType {
 	}
 }
 
+impl From<&DepType> for u8 {
+	fn from(value: &DepType) -> Self {
+		match value {
+			DepType::Depends => 1,
+			DepType::PreDepends => 2,
+			DepType::Suggests => 3,
+			DepType::Recommends => 4,
+			DepType::Conflicts => 5,
+			DepType::Replaces => 6,
+			DepType::Obsoletes => 7,
+			DepType::Breaks => 8,
+			DepType::Enhances => 9,
+		}
+	}
+}
+
 /// A struct representing a Base Dependency.
 pub struct BaseDep<'a> {
 	ptr: RawDependency,
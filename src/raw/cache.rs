@@ -1,5 +1,8 @@
 //! Contains Cache related structs.
 
+use std::fmt;
+use std::time::Duration;
+
 use super::package::RawPackage;
 
 /// This module contains the bindings and structs shared with c++
@@ -10,8 +13,125 @@ pub mod raw {
 		ptr: UniquePtr<PkgCacheFile>,
 	}
 
+	/// Bits set in [`PackageSnapshot::flags`].
+	#[repr(u8)]
+	pub enum SnapshotFlag {
+		/// The package is essential.
+		Essential = 1,
+		/// The package has versions. Packages without versions are virtual.
+		HasVersions = 2,
+	}
+
+	/// Bits of a package that a [`PackageFilter`] can match on.
+	#[repr(u8)]
+	pub enum FilterFlag {
+		/// The package has versions.
+		HasVersions = 1,
+		/// The package is installed.
+		Installed = 2,
+		/// The package is installed and can be upgraded.
+		Upgradable = 4,
+		/// The package is marked as automatically installed.
+		AutoInstalled = 8,
+		/// The package is installed or marked for install, and can be
+		/// autoremoved.
+		AutoRemovable = 16,
+	}
+
+	/// A set of [`FilterFlag`] bits a package must have, and must not have,
+	/// to be included.
+	pub struct PackageFilter {
+		/// Every one of these bits must be set.
+		pub require: u8,
+		/// None of these bits can be set.
+		pub exclude: u8,
+		/// Sort the matching packages by name.
+		pub names: bool,
+	}
+
+	/// Every package in the cache, laid out in columns.
+	///
+	/// Rows are in the same order as [`Cache::begin`] iterates.
+	/// Row `i` of every column belongs to the same package.
+	///
+	/// Version IDs are `u32::MAX` when there is no version.
+	pub struct PackageSnapshot {
+		/// The ID of the package.
+		pub ids: Vec<u32>,
+		/// The name and arch of every package back to back.
+		pub strings: String,
+		/// Offsets into `strings`. The name of row `i` is
+		/// `offsets[2 * i]..offsets[2 * i + 1]` and the arch follows it up to
+		/// `offsets[2 * i + 2]`.
+		pub offsets: Vec<u32>,
+		/// The current state of the package.
+		pub current_state: Vec<u8>,
+		/// The installed state of the package.
+		pub inst_state: Vec<u8>,
+		/// The selected state of the package.
+		pub selected_state: Vec<u8>,
+		/// [`SnapshotFlag`] bits of the package.
+		pub flags: Vec<u8>,
+		/// The ID of the installed version.
+		pub current_version: Vec<u32>,
+		/// The ID of the candidate version.
+		pub candidate_version: Vec<u32>,
+	}
+
 	impl UniquePtr<Records> {}
 
+	/// The pin priority of every version and the candidate of every package.
+	pub struct PolicyTable {
+		/// The priority of each version as shown in `apt policy`,
+		/// indexed by Version ID.
+		pub priorities: Vec<i32>,
+		/// The ID of the candidate version, indexed by Package ID.
+		/// `u32::MAX` if the package has no candidate.
+		pub candidates: Vec<u32>,
+	}
+
+	/// How long each phase of opening the cache took, and why.
+	///
+	/// Times are in microseconds.
+	#[derive(Debug, Clone, Default)]
+	pub struct OpenProfile {
+		/// Setting up the config and system, and adding local debs.
+		/// Adding local debs reads the sources.list files as well.
+		pub create_micros: u64,
+		/// Reading the sources.list files.
+		/// `0` if local debs were added, see `create_micros`.
+		pub sources_micros: u64,
+		/// Building or mapping pkgcache.bin and srcpkgcache.bin.
+		pub caches_micros: u64,
+		/// Loading the pins.
+		pub policy_micros: u64,
+		/// Initializing the DepCache from the dpkg status.
+		pub depcache_micros: u64,
+		/// Opening the package records.
+		pub records_micros: u64,
+		/// True if pkgcache.bin was mapped as it was, without a build.
+		///
+		/// This is checked the way apt checks it before reusing the file:
+		/// each index file has to be in it with the same size and time.
+		/// The check isn't counted in any of the times.
+		pub reused: bool,
+		/// Why the cache was reused or built, from that same check.
+		pub reason: String,
+		/// True if pkgcache.bin was written while opening.
+		pub pkgcache_written: bool,
+		/// True if srcpkgcache.bin was written while opening.
+		pub srcpkgcache_written: bool,
+		/// Bytes of the package cache in memory.
+		pub pkgcache_size: u64,
+		/// Bytes of srcpkgcache.bin on disk, 0 if there isn't one.
+		pub srcpkgcache_size: u64,
+		/// The index files in the cache, including the dpkg status.
+		pub index_files: u32,
+		/// The index files that had to be parsed. The package lists are
+		/// only parsed if srcpkgcache.bin was out of date as well.
+		pub index_files_parsed: u32,
+	}
+
 	unsafe extern "C++" {
 		include!("oma-apt/apt-pkg-c/types.h");
 		include!("oma-apt/apt-pkg-c/package.h");
@@ -29,6 +149,7 @@ pub mod raw {
 
 		type Records = crate::raw::records::raw::Records;
 		type DepCache = crate::raw::depcache::raw::DepCache;
+		type Simulation = crate::raw::depcache::raw::Simulation;
 
 		type DynAcquireProgress = crate::raw::progress::raw::DynAcquireProgress;
 
@@ -50,11 +171,33 @@ pub mod raw {
 
 		pub fn create_depcache(self: &Cache) -> DepCache;
 
+		/// Create a DepCache of its own that shares this cache and policy.
+		///
+		/// Marks start out as they are when the cache is opened.
+		///
+		/// # Safety
+		///
+		/// The Simulation points into this cache, but nothing ties it to
+		/// its lifetime. It must be dropped before the cache is.
+		/// Use [`crate::cache::Cache::simulation`] instead.
+		pub unsafe fn create_simulation(self: &Cache) -> Result<UniquePtr<Simulation>>;
+
 		pub fn create_records(self: &Cache) -> UniquePtr<Records>;
 
 		/// The priority of the Version as shown in `apt policy`.
 		pub fn priority(self: &Cache, version: &Version) -> i32;
 
+		/// Fill a [`PolicyTable`] of every version and package at once.
+		///
+		/// Priorities and candidates are read on many threads.
+		pub fn policy_table(self: &Cache) -> Result<PolicyTable>;
+
+		/// Open the cache one phase at a time and time each phase.
+		///
+		/// Returns an error if the package cache has already been built,
+		/// or if any phase fails.
+		pub fn open_profile(self: &Cache) -> Result<OpenProfile>;
+
 		/// Lookup the IndexFile of the Package file
 		pub fn find_index(self: &Cache, pkg_file: &mut PackageFile);
 
@@ -64,9 +207,35 @@ pub mod raw {
 		/// Return a package by name and optionally architecture.
 		pub fn unsafe_find_pkg(self: &Cache, name: String) -> Package;
 
+		/// Return a package for every name and optionally architecture,
+		/// in the same order.
+		///
+		/// Packages that don't exist are left in place, check with `end()`.
+		pub fn find_pkgs(self: &Cache, names: &[&str]) -> Result<Vec<Package>>;
+
 		/// Return the pointer to the start of the PkgIterator.
 		pub fn begin(self: &Cache) -> Result<Package>;
 
+		/// Fill a [`PackageSnapshot`] of every package in one pass.
+		pub fn snapshot(self: &Cache) -> Result<PackageSnapshot>;
+
+		/// Return the IDs of every package matching the filter.
+		///
+		/// The whole cache is checked in one pass over the packages and their
+		/// DepCache state.
+		pub fn filter_pkgs(self: &Cache, filter: &PackageFilter) -> Result<Vec<u32>>;
+
+		/// Every package in the cache indexed by ID.
+		type PkgTable;
+
+		/// Walk the packages once into a [`PkgTable`].
+		pub fn create_pkg_table(self: &Cache) -> Result<UniquePtr<PkgTable>>;
+
+		/// Return the packages for a list of IDs, in the same order.
+		///
+		/// Errors if any of the IDs are not in the cache.
+		pub fn pkgs_by_id(self: &PkgTable, ids: &[u32]) -> Result<Vec<Package>>;
+
 		pub fn show_broken_package(self: &Cache, pkg: &Package, now: bool);
 
 		pub fn show_broken(self: &Cache, now: bool);
@@ -83,3 +252,99 @@ impl raw::Cache {
 		}
 	}
 }
+
+impl raw::PolicyTable {
+	/// The priority of a version. None if the ID is not in the table.
+	pub fn priority(&self, ver_id: u32) -> Option<i32> {
+		self.priorities.get(ver_id as usize).copied()
+	}
+
+	/// The ID of the candidate version of a package.
+	pub fn candidate(&self, pkg_id: u32) -> Option<u32> {
+		some_id(*self.candidates.get(pkg_id as usize)?)
+	}
+}
+
+impl raw::OpenProfile {
+	/// The time taken by each phase, in order.
+	pub fn phases(&self) -> [(&'static str, Duration); 6] {
+		[
+			("create", Duration::from_micros(self.create_micros)),
+			("sources", Duration::from_micros(self.sources_micros)),
+			("caches", Duration::from_micros(self.caches_micros)),
+			("policy", Duration::from_micros(self.policy_micros)),
+			("depcache", Duration::from_micros(self.depcache_micros)),
+			("records", Duration::from_micros(self.records_micros)),
+		]
+	}
+
+	/// The time taken to open the whole cache.
+	pub fn total(&self) -> Duration { self.phases().iter().map(|(_, time)| *time).sum() }
+}
+
+/// A single line for logs.
+impl fmt::Display for raw::OpenProfile {
+	fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+		write!(f, "cache opened in {:?}:", self.total())?;
+		for (name, time) in self.phases() {
+			write!(f, " {name}={time:?}")?;
+		}
+		write!(
+			f,
+			" reused={} ({}) pkgcache={}B srcpkgcache={}B index_files={}/{}",
+			self.reused,
+			self.reason,
+			self.pkgcache_size,
+			self.srcpkgcache_size,
+			self.index_files_parsed,
+			self.index_files,
+		)
+	}
+}
+
+impl raw::PackageSnapshot {
+	/// The number of packages in the snapshot.
+	pub fn len(&self) -> usize { self.ids.len() }
+
+	/// True if there are no packages in the snapshot.
+	pub fn is_empty(&self) -> bool { self.ids.is_empty() }
+
+	/// The name of the package in row `row`.
+	pub fn name(&self, row: usize) -> &str {
+		&self.strings[self.offsets[2 * row] as usize..self.offsets[2 * row + 1] as usize]
+	}
+
+	/// The arch of the package in row `row`.
+	pub fn arch(&self, row: usize) -> &str {
+		&self.strings[self.offsets[2 * row + 1] as usize..self.offsets[2 * row + 2] as usize]
+	}
+
+	/// True if the package in row `row` is essential.
+	pub fn is_essential(&self, row: usize) -> bool {
+		self.flags[row] & raw::SnapshotFlag::Essential.repr != 0
+	}
+
+	/// True if the package in row `row` has versions.
+	pub fn has_versions(&self, row: usize) -> bool {
+		self.flags[row] & raw::SnapshotFlag::HasVersions.repr != 0
+	}
+
+	/// True if the package in row `row` is installed.
+	pub fn is_installed(&self, row: usize) -> bool { self.current_version(row).is_some() }
+
+	/// The ID of the installed version of the package in row `row`.
+	pub fn current_version(&self, row: usize) -> Option<u32> { some_id(self.current_version[row]) }
+
+	/// The ID of the candidate version of the package in row `row`.
+	pub fn candidate_version(&self, row: usize) -> Option<u32> {
+		some_id(self.candidate_version[row])
+	}
+}
+
+/// ID columns use `u32::MAX` when there is nothing to point at.
+fn some_id(id: u32) -> Option<u32> {
+	match id {
+		u32::MAX => None,
+		id => Some(id),
+	}
+}
@@ -1,10 +1,13 @@
 use super::package::{RawPackage, RawVersion};
+use super::progress::BudgetError;
 
 /// This module contains the bindings and structs shared with c++
 #[cxx::bridge]
 pub mod raw {
 	pub struct DepCache {
 		ptr: UniquePtr<PkgDepCache>,
+		/// The packages whose marks changed, see [`DepCache::journal`].
+		journal_ptr: UniquePtr<ChangeJournal>,
 	}
 
 	/// An action group is a group of actions that are currently being
@@ -39,6 +42,57 @@ pub mod raw {
 		ptr: UniquePtr<PkgActionGroup>,
 	}
 
+	/// Bits set in [`PkgState::flags`].
+	#[repr(u16)]
+	pub enum StateFlag {
+		/// The package is marked as automatically installed.
+		Auto = 1,
+		/// The package can be autoremoved.
+		Garbage = 2,
+		/// The installed version has broken dependencies.
+		NowBroken = 4,
+		/// The version to be installed has broken dependencies.
+		InstBroken = 8,
+		/// The package is installed and can be upgraded.
+		Upgradable = 16,
+		/// The package is marked for install and isn't installed.
+		NewInstall = 32,
+		/// The package is marked for upgrade.
+		Upgrade = 64,
+		/// The package is marked for downgrade.
+		Downgrade = 128,
+		/// The package is marked for removal.
+		Delete = 256,
+		/// The package is marked to be purged.
+		Purge = 512,
+		/// The package is marked for reinstall.
+		ReInstall = 1024,
+		/// The package is marked for keep.
+		Keep = 2048,
+	}
+
+	/// How a budgeted operation ended.
+	#[derive(Debug)]
+	pub enum BudgetStatus {
+		/// The operation finished within the budget.
+		Finished,
+		/// The operation finished within the budget, but failed.
+		Failed,
+		/// The budget ran out. The DepCache is as it was before the operation.
+		Exceeded,
+	}
+
+	/// The DepCache state of a package.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+	pub struct PkgState {
+		/// The raw mode. Taken from 'depcache.h pkgDepCache::ModeList'
+		pub mode: u8,
+		/// [`StateFlag`] bits.
+		pub flags: u16,
+		/// The ID of the candidate version, `u32::MAX` if there is none.
+		pub candidate: u32,
+	}
+
 	unsafe extern "C++" {
 		include!("oma-apt/apt-pkg-c/types.h");
 		include!("oma-apt/apt-pkg-c/package.h");
@@ -48,6 +102,16 @@ pub mod raw {
 
 		type PkgDepCache;
 		type PkgActionGroup;
+		type ChangeJournal;
+		/// A copy of every mark in a [`DepCache`].
+		type DepCacheCheckpoint;
+
+		/// A DepCache of its own over a shared cache and policy,
+		/// for trying out marks. Packages are given by ID.
+		///
+		/// The cache they came from has to outlive them.
+		/// See [`crate::depcache::Simulation`].
+		type Simulation;
 		type Package = crate::raw::package::raw::Package;
 		type Version = crate::raw::package::raw::Version;
 		type DynOperationProgress = crate::raw::progress::raw::DynOperationProgress;
@@ -57,6 +121,13 @@ pub mod raw {
 		/// Autoinstall every broken package and run the problem resolver
 		/// Returns false if the problem resolver fails.
 		pub fn fix_broken(self: &DepCache) -> bool;
+
+		/// Like [`DepCache::fix_broken`], but within the budget of the
+		/// progress. The marks are put back if it ran out.
+		pub fn fix_broken_budgeted(
+			self: &DepCache,
+			progress: &mut DynOperationProgress,
+		) -> BudgetStatus;
 		/// Return a new [`ActionGroup`] of the current DepCache
 		///
 		/// ActionGroup will be released once it leaves scope
@@ -78,6 +149,18 @@ pub mod raw {
 		/// New packages will be installed but nothing will be removed.
 		pub fn install_upgrade(self: &DepCache, progress: &mut DynOperationProgress) -> Result<()>;
 
+		/// Perform an upgrade within the budget of the progress.
+		/// The marks are put back if it ran out.
+		///
+		/// `allow_remove` and `allow_new` allow removing packages and
+		/// installing new ones. Both are a Full Upgrade.
+		pub fn upgrade_budgeted(
+			self: &DepCache,
+			allow_remove: bool,
+			allow_new: bool,
+			progress: &mut DynOperationProgress,
+		) -> Result<BudgetStatus>;
+
 		/// Check if the package is upgradable.
 		///
 		/// ## skip_depcache:
@@ -176,6 +259,28 @@ pub mod raw {
 			from_user: bool,
 		) -> bool;
 
+		/// Mark many packages for installation by ID, in order.
+		///
+		/// Every mark is made in one [`ActionGroup`], so autoremove
+		/// bookkeeping runs once at the end instead of after every mark.
+		/// Returns whether each mark was successful.
+		/// Nothing is marked if any of the IDs are not in the cache.
+		pub fn mark_install_many(
+			self: &DepCache,
+			pkg_ids: &[u32],
+			auto_inst: bool,
+			from_user: bool,
+		) -> Result<Vec<bool>>;
+
+		/// Mark many packages for removal by ID, in one [`ActionGroup`].
+		/// Returns whether each mark was successful.
+		pub fn mark_delete_many(self: &DepCache, pkg_ids: &[u32], purge: bool)
+			-> Result<Vec<bool>>;
+
+		/// Mark many packages as automatically or manually installed by ID,
+		/// in one [`ActionGroup`]. This can't fail for a package in the cache.
+		pub fn mark_auto_many(self: &DepCache, pkg_ids: &[u32], mark_auto: bool) -> Result<()>;
+
 		/// Set a version to be the candidate of it's package.
 		pub fn set_candidate_version(self: &DepCache, ver: &Version);
 
@@ -202,6 +307,82 @@ pub mod raw {
 		/// Is the Package to be installed broken?
 		pub fn is_inst_broken(self: &DepCache, pkg: &Package) -> bool;
 
+		/// Return the state of every package, indexed by Package ID.
+		///
+		/// This is every `marked_*`, `is_*` and candidate lookup
+		/// for the whole cache in one call.
+		pub fn state_snapshot(self: &DepCache) -> Vec<PkgState>;
+
+		/// Copy every mark and the counters that go with them.
+		///
+		/// This is a copy of two arrays the size of the cache,
+		/// restoring it is much cheaper than calling `init`.
+		/// Returns an error if they can't be allocated.
+		pub fn checkpoint(self: &DepCache) -> Result<UniquePtr<DepCacheCheckpoint>>;
+
+		/// Put back the marks from a checkpoint. Nothing is recalculated.
+		///
+		/// Returns an error if the checkpoint is from a different cache.
+		pub fn restore(self: &DepCache, checkpoint: &DepCacheCheckpoint) -> Result<()>;
+
+		// Simulation Declarations
+		/// Mark a package for installation.
+		/// Returns an error if the ID is not in the cache.
+		pub fn mark_install(self: &Simulation, pkg_id: u32, auto_inst: bool) -> Result<bool>;
+
+		/// Mark a package for removal.
+		/// Returns an error if the ID is not in the cache.
+		pub fn mark_delete(self: &Simulation, pkg_id: u32, purge: bool) -> Result<bool>;
+
+		/// Run the problem resolver on the simulation.
+		pub fn resolve(self: &Simulation, fix_broken: bool) -> Result<()>;
+
+		/// Put back the marks the simulation started with.
+		pub fn reset(self: &Simulation) -> Result<()>;
+
+		/// The size of all packages to be downloaded.
+		pub fn download_size(self: &Simulation) -> u64;
+
+		/// The Installed-Size of the packages to install minus those to remove.
+		pub fn disk_size(self: &Simulation) -> i64;
+
+		/// The number of packages marked for installation.
+		pub fn install_count(self: &Simulation) -> u32;
+
+		/// The number of packages marked for removal.
+		pub fn delete_count(self: &Simulation) -> u32;
+
+		/// The number of packages with broken dependencies.
+		pub fn broken_count(self: &Simulation) -> u32;
+
+		/// Return the ID of every package whose marks changed since the
+		/// journal was last reset, in the order they were found.
+		///
+		/// A package is in the journal once, even if it changed back.
+		/// Marks made in any way are seen, including the dependencies of
+		/// `mark_install`, upgrades and the problem resolver.
+		///
+		/// The journal starts the first time any journal method is called,
+		/// or a `*_many` mark is made. Reading it compares the state of
+		/// every package with the journal's copy.
+		pub fn journal(self: &DepCache) -> Vec<u32>;
+
+		/// Start the journal over from the current marks.
+		pub fn reset_journal(self: &DepCache);
+
+		/// Return the ID of every package that is marked to change,
+		/// in the same order as walking the cache.
+		///
+		/// apt can't tell us when a mark changes, so this is still a pass
+		/// over the state of every package, made in one call rather than
+		/// one call per package.
+		pub fn changed_pkgs(self: &DepCache) -> Vec<u32>;
+
+		/// Like [`DepCache::changed_pkgs`], but return the packages.
+		///
+		/// They are taken from the journal, without a lookup by ID.
+		pub fn changed_packages(self: &DepCache) -> Vec<Package>;
+
 		/// The number of packages marked for installation.
 		pub fn install_count(self: &DepCache) -> u32;
 
@@ -225,6 +406,43 @@ pub mod raw {
 	}
 }
 
+impl raw::PkgState {
+	/// True if the flag is set.
+	pub fn is(&self, flag: raw::StateFlag) -> bool { self.flags & flag.repr != 0 }
+
+	/// True if the package is marked to change in any way.
+	pub fn is_changed(&self) -> bool {
+		[
+			raw::StateFlag::NewInstall,
+			raw::StateFlag::Delete,
+			raw::StateFlag::Upgrade,
+			raw::StateFlag::Downgrade,
+			raw::StateFlag::ReInstall,
+		]
+		.into_iter()
+		.any(|flag| self.is(flag))
+	}
+
+	/// The ID of the candidate version.
+	pub fn candidate(&self) -> Option<u32> {
+		match self.candidate {
+			u32::MAX => None,
+			id => Some(id),
+		}
+	}
+}
+
+impl raw::BudgetStatus {
+	/// Whether the operation succeeded, or [`BudgetError::Exceeded`].
+	pub fn finished(&self) -> Result<bool, BudgetError> {
+		match *self {
+			raw::BudgetStatus::Finished => Ok(true),
+			raw::BudgetStatus::Exceeded => Err(BudgetError::Exceeded),
+			_ => Ok(false),
+		}
+	}
+}
+
 impl raw::DepCache {
 	pub fn candidate_version(&self, pkg: &RawPackage) -> Option<RawVersion> {
 		let ptr = self.unsafe_candidate_version(pkg);
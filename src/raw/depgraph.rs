@@ -0,0 +1,256 @@
+//! Contains the dependency graph of the cache.
+
+use std::ops::Range;
+
+use crate::package::DepType;
+
+/// This module contains the bindings and structs shared with c++
+#[cxx::bridge]
+pub mod raw {
+	/// Every dependency in the cache in compressed sparse row form.
+	///
+	/// Each dependency is an edge. Edges are numbered by their index in the
+	/// edge columns `targets`, `parents`, `dep_types`, `comp_ops` and
+	/// `target_versions`.
+	///
+	/// The edges of the version with ID `v` are
+	/// `ver_offsets[v]..ver_offsets[v + 1]`, in the order of its depends list.
+	/// The reverse edges of the package with ID `p` are
+	/// `rev_edges[pkg_offsets[p]..pkg_offsets[p + 1]]`.
+	/// The other columns indexed by Package ID are laid out the same way.
+	pub struct DepGraph {
+		/// Offsets into the edge columns, indexed by Version ID.
+		pub ver_offsets: Vec<u32>,
+		/// The ID of the package each edge targets.
+		pub targets: Vec<u32>,
+		/// The ID of the version each edge belongs to.
+		pub parents: Vec<u32>,
+		/// The dependency type. Taken from 'pkgcache.cc pkgCache::DepType'
+		pub dep_types: Vec<u8>,
+		/// The raw compare op. The low bits are 'pkgCache::Dep::DepCompareOp'
+		/// and `0x10` is set if the edge is Or'd with the next.
+		pub comp_ops: Vec<u8>,
+		/// The ID of the target version string, `u32::MAX` if there is none.
+		pub target_versions: Vec<u32>,
+		/// Every target version string back to back.
+		pub strings: String,
+		/// Offsets into `strings`. String `i` is
+		/// `string_offsets[i]..string_offsets[i + 1]`.
+		pub string_offsets: Vec<u32>,
+		/// Offsets into `rev_edges`, indexed by Package ID.
+		pub pkg_offsets: Vec<u32>,
+		/// Edges that target each package.
+		pub rev_edges: Vec<u32>,
+		/// The ID of the package each version belongs to,
+		/// indexed by Version ID.
+		pub ver_pkgs: Vec<u32>,
+		/// Offsets into `pkg_vers`, indexed by Package ID.
+		pub pkg_ver_offsets: Vec<u32>,
+		/// The Version IDs of each package, newest first.
+		pub pkg_vers: Vec<u32>,
+		/// Offsets into `providers`, indexed by Package ID.
+		pub provider_offsets: Vec<u32>,
+		/// The IDs of the packages that provide each package.
+		pub providers: Vec<u32>,
+		/// Offsets into `provides`, indexed by Package ID.
+		pub provide_offsets: Vec<u32>,
+		/// The IDs of the packages that the versions of each package provide.
+		pub provides: Vec<u32>,
+	}
+
+	/// What to follow when walking the closure of a package.
+	#[derive(Debug, Clone, Copy)]
+	pub struct ClosureQuery {
+		/// Walk the packages that depend on the root, instead of the packages
+		/// the root depends on.
+		pub reverse: bool,
+		/// Bit `1 << t` is set for every dependency type `t` to follow.
+		/// Types are from 'pkgcache.cc pkgCache::DepType'
+		/// A query without any types is an error.
+		pub dep_types: u16,
+		/// How many dependencies away from the root to go. `0` is no limit.
+		pub max_depth: u32,
+		/// Follow dependencies that have alternatives.
+		/// Otherwise only dependencies without an Or group are followed.
+		pub or_groups: bool,
+		/// Follow Provides. Forward, the providers of a target are included.
+		/// In reverse, the packages that depend on what a package provides
+		/// are included.
+		pub provides: bool,
+		/// Only follow the dependencies of candidate versions.
+		/// Otherwise every version of a package is followed.
+		pub candidates: bool,
+	}
+
+	/// The closure of each root as sorted Package IDs.
+	///
+	/// The closure of root `i` is `ids[offsets[i]..offsets[i + 1]]`.
+	/// A root is not part of its own closure.
+	pub struct ClosureSets {
+		pub offsets: Vec<u32>,
+		pub ids: Vec<u32>,
+	}
+
+	unsafe extern "C++" {
+		include!("oma-apt/apt-pkg-c/cache.h");
+		include!("oma-apt/apt-pkg-c/util.h");
+		include!("oma-apt/apt-pkg-c/depgraph.h");
+
+		type Cache = crate::raw::cache::raw::Cache;
+
+		/// Walk every dependency in the cache once and build the graph.
+		pub fn create_dep_graph(cache: &Cache) -> Result<DepGraph>;
+
+		/// Walk the closure of every root Package ID over the graph.
+		///
+		/// `candidates` is the candidate Version ID of every package, as in
+		/// [`PolicyTable`](crate::raw::cache::raw::PolicyTable). It is only
+		/// read if the query follows candidates.
+		///
+		/// Roots are walked in parallel. Returns an error if a root is not
+		/// in the graph or the query doesn't follow any dependency types.
+		pub fn dep_closure(
+			graph: &DepGraph,
+			candidates: &[u32],
+			roots: &[u32],
+			query: &ClosureQuery,
+		) -> Result<ClosureSets>;
+	}
+}
+
+/// Set in [`raw::DepGraph::comp_ops`] if the edge is Or'd with the next.
+const OR: u8 = 0x10;
+
+impl raw::DepGraph {
+	/// The number of edges in the graph.
+	pub fn len(&self) -> usize { self.targets.len() }
+
+	pub fn is_empty(&self) -> bool { self.targets.is_empty() }
+
+	/// The edges of a version. Empty if the ID is not in the graph.
+	pub fn depends(&self, ver_id: u32) -> Range<usize> { row(&self.ver_offsets, ver_id as usize) }
+
+	/// The edges that target a package. Empty if the ID is not in the graph.
+	pub fn rdepends(&self, pkg_id: u32) -> &[u32] {
+		&self.rev_edges[row(&self.pkg_offsets, pkg_id as usize)]
+	}
+
+	/// The compare op of an edge without the Or bit.
+	pub fn comp_op(&self, edge: usize) -> u8 { self.comp_ops[edge] & !OR }
+
+	/// True if the edge is Or'd with the next.
+	/// The last edge of an Or group is false.
+	pub fn is_or(&self, edge: usize) -> bool { self.comp_ops[edge] & OR != 0 }
+
+	/// The Or group an edge belongs to, as a range of edges.
+	pub fn or_group(&self, edge: usize) -> Range<usize> {
+		let row = self.depends(self.parents[edge]);
+
+		let mut start = edge;
+		while start > row.start && self.is_or(start - 1) {
+			start -= 1;
+		}
+
+		let mut end = edge;
+		while end + 1 < row.end && self.is_or(end) {
+			end += 1;
+		}
+		start..end + 1
+	}
+
+	/// The target version of an edge, if there is one.
+	pub fn target_ver(&self, edge: usize) -> Option<&str> {
+		let id = self.target_versions[edge] as usize;
+		if id == u32::MAX as usize {
+			return None;
+		}
+		let start = self.string_offsets[id] as usize;
+		let end = self.string_offsets[id + 1] as usize;
+		Some(&self.strings[start..end])
+	}
+}
+
+impl raw::ClosureQuery {
+	/// Follow the dependencies of a package.
+	///
+	/// Depends and PreDepends are followed,
+	/// change this with [`Self::dep_type`] and [`Self::dep_types`].
+	pub fn forward() -> Self {
+		raw::ClosureQuery {
+			reverse: false,
+			dep_types: 1 << u8::from(&DepType::Depends) | 1 << u8::from(&DepType::PreDepends),
+			max_depth: 0,
+			or_groups: true,
+			provides: true,
+			candidates: false,
+		}
+	}
+
+	/// Follow the packages that depend on a package.
+	///
+	/// Depends and PreDepends are followed,
+	/// change this with [`Self::dep_type`] and [`Self::dep_types`].
+	pub fn reverse() -> Self {
+		raw::ClosureQuery {
+			reverse: true,
+			..Self::forward()
+		}
+	}
+
+	/// Also follow this type of dependency.
+	pub fn dep_type(mut self, dep_type: DepType) -> Self {
+		self.dep_types |= 1 << u8::from(&dep_type);
+		self
+	}
+
+	/// Follow only these types of dependency.
+	pub fn dep_types(mut self, dep_types: &[DepType]) -> Self {
+		self.dep_types = 0;
+		for dep_type in dep_types {
+			self.dep_types |= 1 << u8::from(dep_type);
+		}
+		self
+	}
+
+	/// Stop this many dependencies away from the root.
+	pub fn max_depth(mut self, depth: u32) -> Self {
+		self.max_depth = depth;
+		self
+	}
+
+	/// Set whether dependencies with alternatives are followed.
+	pub fn or_groups(mut self, follow: bool) -> Self {
+		self.or_groups = follow;
+		self
+	}
+
+	/// Set whether Provides are followed.
+	pub fn provides(mut self, follow: bool) -> Self {
+		self.provides = follow;
+		self
+	}
+
+	/// Set whether only candidate versions are followed.
+	pub fn candidates(mut self, only: bool) -> Self {
+		self.candidates = only;
+		self
+	}
+}
+
+impl raw::ClosureSets {
+	/// The number of roots.
+	pub fn len(&self) -> usize { self.offsets.len().saturating_sub(1) }
+
+	pub fn is_empty(&self) -> bool { self.len() == 0 }
+
+	/// The closure of a root by its position in the roots.
+	pub fn get(&self, root: usize) -> &[u32] { &self.ids[row(&self.offsets, root)] }
+}
+
+/// Get a row out of CSR offsets.
+fn row(offsets: &[u32], index: usize) -> Range<usize> {
+	match offsets.get(index..index + 2) {
+		Some(range) => range[0] as usize..range[1] as usize,
+		None => 0..0,
+	}
+}
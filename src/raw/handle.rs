@@ -0,0 +1,178 @@
+//! Allocation free handles to items in the cache.
+//!
+//! The structs in [`crate::raw::package`] each own a heap allocated
+//! iterator, so walking a dependency graph allocates for every edge.
+//!
+//! Handles are the offset of an item in the cache.
+//! They are `Copy`, and the iterator is rebuilt on the stack in C++ for every
+//! call. A handle with an offset of `0` is the end of a list.
+//!
+//! Handles are only valid for the [`Cache`](crate::raw::cache::raw::Cache)
+//! they came from. Every function checks that the handle is inside the
+//! cache and returns an error for the end or a forged handle, but a handle
+//! from another cache may still point at the wrong item.
+
+/// This module contains the bindings and structs shared with c++
+#[cxx::bridge]
+pub mod raw {
+	/// A handle to a Package.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+	pub struct PkgHandle {
+		pub offset: u32,
+	}
+
+	/// A handle to a Version.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+	pub struct VerHandle {
+		pub offset: u32,
+	}
+
+	/// A handle to a Dependency.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+	pub struct DepHandle {
+		pub offset: u32,
+		/// True if this came from a reverse depends list.
+		pub reverse: bool,
+	}
+
+	/// A handle to a Provider.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+	pub struct PrvHandle {
+		pub offset: u32,
+		/// True if this came from the provides list of a package,
+		/// false if from a version.
+		pub by_pkg: bool,
+	}
+
+	unsafe extern "C++" {
+		include!("oma-apt/apt-pkg-c/cache.h");
+		include!("oma-apt/apt-pkg-c/util.h");
+		include!("oma-apt/apt-pkg-c/handle.h");
+
+		type Cache = crate::raw::cache::raw::Cache;
+
+		/// Return a handle to every package in the cache.
+		pub fn all_pkgs(cache: &Cache) -> Result<Vec<PkgHandle>>;
+
+		/// Return a package by name and optionally architecture.
+		/// The handle is the end if the package doesn't exist.
+		pub fn find_pkg_handle(cache: &Cache, name: &str) -> Result<PkgHandle>;
+
+		// Package Declarations
+		pub fn pkg_name<'a>(cache: &'a Cache, pkg: PkgHandle) -> Result<&'a str>;
+		pub fn pkg_arch<'a>(cache: &'a Cache, pkg: PkgHandle) -> Result<&'a str>;
+		pub fn pkg_id(cache: &Cache, pkg: PkgHandle) -> Result<u32>;
+		pub fn pkg_current_ver(cache: &Cache, pkg: PkgHandle) -> Result<VerHandle>;
+		pub fn pkg_version_list(cache: &Cache, pkg: PkgHandle) -> Result<VerHandle>;
+		pub fn pkg_rev_depends(cache: &Cache, pkg: PkgHandle) -> Result<DepHandle>;
+		pub fn pkg_provides(cache: &Cache, pkg: PkgHandle) -> Result<PrvHandle>;
+
+		// Version Declarations
+		pub fn ver_str<'a>(cache: &'a Cache, ver: VerHandle) -> Result<&'a str>;
+		pub fn ver_id(cache: &Cache, ver: VerHandle) -> Result<u32>;
+		pub fn ver_next(cache: &Cache, ver: VerHandle) -> Result<VerHandle>;
+		pub fn ver_parent_pkg(cache: &Cache, ver: VerHandle) -> Result<PkgHandle>;
+		pub fn ver_depends(cache: &Cache, ver: VerHandle) -> Result<DepHandle>;
+		pub fn ver_provides(cache: &Cache, ver: VerHandle) -> Result<PrvHandle>;
+
+		// Dependency Declarations
+		pub fn dep_next(cache: &Cache, dep: DepHandle) -> Result<DepHandle>;
+		pub fn dep_target_pkg(cache: &Cache, dep: DepHandle) -> Result<PkgHandle>;
+		pub fn dep_parent_pkg(cache: &Cache, dep: DepHandle) -> Result<PkgHandle>;
+		pub fn dep_parent_ver(cache: &Cache, dep: DepHandle) -> Result<VerHandle>;
+		/// The dependency type. Taken from 'pkgcache.cc pkgCache::DepType'
+		pub fn dep_type(cache: &Cache, dep: DepHandle) -> Result<u8>;
+		/// Return true if this dep is Or'd with the next.
+		pub fn dep_compare_op(cache: &Cache, dep: DepHandle) -> Result<bool>;
+		pub fn dep_comp_type<'a>(cache: &'a Cache, dep: DepHandle) -> Result<&'a str>;
+		pub fn dep_target_ver<'a>(cache: &'a Cache, dep: DepHandle) -> Result<&'a str>;
+
+		// Provider Declarations
+		pub fn prv_next(cache: &Cache, prv: PrvHandle) -> Result<PrvHandle>;
+		pub fn prv_name<'a>(cache: &'a Cache, prv: PrvHandle) -> Result<&'a str>;
+		pub fn prv_version_str<'a>(cache: &'a Cache, prv: PrvHandle) -> Result<&'a str>;
+		pub fn prv_target_pkg(cache: &Cache, prv: PrvHandle) -> Result<PkgHandle>;
+		pub fn prv_target_ver(cache: &Cache, prv: PrvHandle) -> Result<VerHandle>;
+	}
+}
+
+use cxx::Exception;
+use raw::{Cache, DepHandle, PkgHandle, PrvHandle, VerHandle};
+
+/// Implement `end`, `next` and an iterator for a handle type.
+macro_rules! handle_list {
+	($handle:ident, $iter:ident, $next:path) => {
+		impl $handle {
+			/// True if this handle is the end of a list.
+			#[inline]
+			pub fn end(&self) -> bool { self.offset == 0 }
+
+			/// Iterate from this handle to the end of its list.
+			pub fn iter(self, cache: &Cache) -> $iter<'_> { $iter { cache, next: self } }
+		}
+
+		/// Iterator over a list of handles.
+		///
+		/// Stops after the first error.
+		pub struct $iter<'a> {
+			cache: &'a Cache,
+			next: $handle,
+		}
+
+		impl<'a> Iterator for $iter<'a> {
+			type Item = Result<$handle, Exception>;
+
+			fn next(&mut self) -> Option<Self::Item> {
+				if self.next.end() {
+					return None;
+				}
+				let current = self.next;
+				match $next(self.cache, current) {
+					Ok(next) => self.next = next,
+					Err(err) => {
+						self.next.offset = 0;
+						return Some(Err(err));
+					},
+				}
+				Some(Ok(current))
+			}
+		}
+	};
+}
+
+handle_list!(VerHandle, VerHandles, raw::ver_next);
+handle_list!(DepHandle, DepHandles, raw::dep_next);
+handle_list!(PrvHandle, PrvHandles, raw::prv_next);
+
+impl PkgHandle {
+	/// True if the package doesn't exist.
+	#[inline]
+	pub fn end(&self) -> bool { self.offset == 0 }
+
+	/// The versions of the package, newest first.
+	pub fn versions(self, cache: &Cache) -> Result<VerHandles<'_>, Exception> {
+		Ok(raw::pkg_version_list(cache, self)?.iter(cache))
+	}
+
+	/// The dependencies that target the package.
+	pub fn rev_depends(self, cache: &Cache) -> Result<DepHandles<'_>, Exception> {
+		Ok(raw::pkg_rev_depends(cache, self)?.iter(cache))
+	}
+
+	/// The versions that provide the package.
+	pub fn provides(self, cache: &Cache) -> Result<PrvHandles<'_>, Exception> {
+		Ok(raw::pkg_provides(cache, self)?.iter(cache))
+	}
+}
+
+impl VerHandle {
+	/// The dependencies of the version.
+	pub fn depends(self, cache: &Cache) -> Result<DepHandles<'_>, Exception> {
+		Ok(raw::ver_depends(cache, self)?.iter(cache))
+	}
+
+	/// The packages the version provides.
+	pub fn provides(self, cache: &Cache) -> Result<PrvHandles<'_>, Exception> {
+		Ok(raw::ver_provides(cache, self)?.iter(cache))
+	}
+}
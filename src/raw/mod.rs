@@ -1,8 +1,12 @@
 pub mod cache;
 pub mod config;
 pub mod depcache;
+pub mod depgraph;
+pub mod handle;
 pub mod package;
 pub mod pkgmanager;
 pub mod progress;
 pub mod records;
+pub mod search;
+pub mod tagfile;
 pub mod util;
@@ -15,6 +15,8 @@ pub mod raw {
 	// SourceURI is defined here, but used in the cache.
 	// We need to impl vec so it can be put in one.
 	impl Vec<SourceURI> {}
+	// Packages are returned in bulk from the cache by ID.
+	impl Vec<Package> {}
 	#[derive(Debug)]
 	pub struct SourceURI {
 		pub uri: String,
@@ -656,9 +658,13 @@ mod raw_tests {
 
 		let records = cache.create_records();
 
-		records.ver_file_lookup(&cand.version_files().unwrap().next().unwrap());
+		records
+			.ver_file_lookup(&cand.version_files().unwrap().next().unwrap())
+			.unwrap();
 		dbg!(records.short_desc().unwrap());
-		records.desc_file_lookup(&cand.description_files().unwrap().next().unwrap());
+		records
+			.desc_file_lookup(&cand.description_files().unwrap().next().unwrap())
+			.unwrap();
 		dbg!(records.long_desc().unwrap());
 
 		let mut pkg_file = cand.version_files().unwrap().next().unwrap().pkg_file();
@@ -1,14 +1,38 @@
 //! Contains types and bindings for fetching and installing packages from the
 //! cache.
 
+use std::time::Duration;
+
 /// This module contains the bindings and structs shared with c++
 #[cxx::bridge]
 pub mod raw {
+	/// Measurements of a single run of the problem resolver.
+	#[derive(Debug, Clone)]
+	pub struct ResolverStats {
+		/// Wall time of the whole solve in microseconds.
+		pub micros: u64,
+		/// True if the resolver fixed every broken package.
+		pub resolved: bool,
+		/// The errors from a failed solve, empty if there were none.
+		pub error: String,
+		/// Broken packages before the solve.
+		pub broken_before: u32,
+		/// Broken packages after the solve.
+		pub broken_after: u32,
+		/// Packages that ended up kept that weren't before the solve.
+		pub kept: u32,
+		/// Packages that ended up removed that weren't before the solve.
+		pub removed: u32,
+		/// Packages that ended up installed that weren't before the solve.
+		pub installed: u32,
+	}
+
 	unsafe extern "C++" {
 		include!("oma-apt/apt-pkg-c/progress.h");
 		include!("oma-apt/apt-pkg-c/cache.h");
 		include!("oma-apt/apt-pkg-c/records.h");
 		include!("oma-apt/apt-pkg-c/util.h");
+		include!("oma-apt/apt-pkg-c/depcache.h");
 		include!("oma-apt/apt-pkg-c/pkgmanager.h");
 
 		type PackageManager;
@@ -17,6 +41,7 @@ pub mod raw {
 		type Cache = crate::raw::cache::raw::Cache;
 		type Package = crate::raw::cache::raw::Package;
 		type Records = crate::raw::records::raw::Records;
+		type BudgetStatus = crate::raw::depcache::raw::BudgetStatus;
 		type DynAcquireProgress = crate::raw::progress::raw::DynAcquireProgress;
 		type DynInstallProgress = crate::raw::progress::raw::DynInstallProgress;
 		type DynOperationProgress = crate::raw::progress::raw::DynOperationProgress;
@@ -44,5 +69,27 @@ pub mod raw {
 			fix_broken: bool,
 			op_progress: &mut DynOperationProgress,
 		) -> Result<()>;
+
+		/// Resolve within the budget of the progress.
+		/// The marks are put back if it ran out.
+		pub fn resolve_budgeted(
+			self: &ProblemResolver,
+			fix_broken: bool,
+			op_progress: &mut DynOperationProgress,
+		) -> Result<BudgetStatus>;
+
+		/// Resolve and return how the solve went.
+		///
+		/// A failed solve isn't an error here, see [`ResolverStats::error`].
+		pub fn resolve_with_stats(
+			self: &ProblemResolver,
+			fix_broken: bool,
+			op_progress: &mut DynOperationProgress,
+		) -> ResolverStats;
 	}
 }
+
+impl raw::ResolverStats {
+	/// Wall time of the whole solve.
+	pub fn wall_time(&self) -> Duration { Duration::from_micros(self.micros) }
+}
@@ -1,8 +1,12 @@
 //! Contains Progress struct for updating the package list.
-use std::fmt::Write as _;
+use std::error::Error;
+use std::fmt::{self, Write as _};
 use std::io::{stdout, Write};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
 
-use cxx::ExternType;
+use cxx::{Exception, ExternType};
 
 use crate::config::Config;
 // use crate::config::Config;
@@ -58,6 +62,13 @@ pub trait AcquireProgress {
 pub trait OperationProgress {
 	fn update(&mut self, operation: String, percent: f32);
 	fn done(&mut self);
+
+	/// Return true once the operation is over its budget.
+	/// It is then undone when it finishes.
+	///
+	/// Only budgeted operations such as
+	/// [`crate::cache::Cache::resolve_budgeted`] ask.
+	fn cancelled(&mut self) -> bool { false }
 }
 
 /// Internal struct to pass into [`self::Cache::resolve`]. The C++ library for
@@ -79,6 +90,94 @@ impl OperationProgress for NoOpProgress {
 	fn done(&mut self) {}
 }
 
+/// A deadline and cancellation token for budgeted operations.
+///
+/// Clones share the token, so a clone can be sent to another thread and
+/// cancel the operation from there.
+///
+/// apt can't be stopped midway through an operation. The budget is checked
+/// before it, at each progress update and after it. An operation that runs
+/// over is undone, not cut short.
+///
+/// # Example:
+///
+/// ```
+/// use std::time::Duration;
+///
+/// use oma_apt::new_cache;
+/// use oma_apt::raw::progress::Budget;
+///
+/// let cache = new_cache!().unwrap();
+/// let budget = Budget::new().timeout(Duration::from_secs(5));
+///
+/// cache.resolve_budgeted(false, &budget).unwrap();
+/// ```
+#[derive(Debug, Clone, Default)]
+pub struct Budget {
+	deadline: Option<Instant>,
+	cancel: Arc<AtomicBool>,
+}
+
+impl Budget {
+	/// A budget without a deadline. It only runs out when cancelled.
+	pub fn new() -> Self { Self::default() }
+
+	/// Run out at `deadline`.
+	pub fn deadline(mut self, deadline: Instant) -> Self {
+		self.deadline = Some(deadline);
+		self
+	}
+
+	/// Run out `timeout` from now.
+	pub fn timeout(self, timeout: Duration) -> Self { self.deadline(Instant::now() + timeout) }
+
+	/// Cancel every operation using this budget or a clone of it.
+	pub fn cancel(&self) { self.cancel.store(true, Ordering::Relaxed) }
+
+	/// True if the budget was cancelled or the deadline has passed.
+	pub fn is_exceeded(&self) -> bool {
+		if self.cancel.load(Ordering::Relaxed) {
+			return true;
+		}
+		matches!(self.deadline, Some(deadline) if Instant::now() >= deadline)
+	}
+
+	/// Return a clone of the budget in a box to pass to C++.
+	pub fn new_box(&self) -> Box<dyn OperationProgress> { Box::new(self.clone()) }
+}
+
+impl OperationProgress for Budget {
+	fn update(&mut self, _: String, _: f32) {}
+
+	fn done(&mut self) {}
+
+	fn cancelled(&mut self) -> bool { self.is_exceeded() }
+}
+
+/// The error from a budgeted operation.
+#[derive(Debug)]
+pub enum BudgetError {
+	/// The budget ran out. The DepCache is as it was before the operation.
+	Exceeded,
+	/// apt returned an error.
+	Apt(Exception),
+}
+
+impl fmt::Display for BudgetError {
+	fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+		match self {
+			BudgetError::Exceeded => write!(f, "Budget Exceeded"),
+			BudgetError::Apt(err) => write!(f, "{err}"),
+		}
+	}
+}
+
+impl Error for BudgetError {}
+
+impl From<Exception> for BudgetError {
+	fn from(err: Exception) -> Self { BudgetError::Apt(err) }
+}
+
 /// Trait you can impl on any struct to customize the output of installation
 /// progress.
 pub trait InstallProgress {
@@ -547,6 +646,9 @@ pub mod raw {
 		/// Called when an operation has finished.
 		fn op_done(progress: &mut DynOperationProgress);
 
+		/// Called during budgeted operations to see if the budget ran out.
+		fn op_cancelled(progress: &mut DynOperationProgress) -> bool;
+
 		///
 		fn inst_status_changed(
 			progress: &mut DynInstallProgress,
@@ -670,6 +772,9 @@ fn op_update(progress: &mut Box<dyn OperationProgress>, operation: String, perce
 /// Called when an operation has finished.
 fn op_done(progress: &mut Box<dyn OperationProgress>) { (**progress).done() }
 
+/// Called during budgeted operations to see if the budget ran out.
+fn op_cancelled(progress: &mut Box<dyn OperationProgress>) -> bool { (**progress).cancelled() }
+
 // End OperationProgress trait functions
 
 // Begin InstallProgress trait functions
@@ -1,16 +1,71 @@
 /// This module contains the bindings and structs shared with c++
 #[cxx::bridge]
 pub mod raw {
+	/// Record fields of many versions, laid out in a table.
+	///
+	/// Row `r` is the version at position `r` of the Version IDs that were
+	/// asked for, column `c` is the field at position `c`.
+	///
+	/// Fields that don't exist, and versions without a record, are empty.
+	pub struct RecordTable {
+		/// The number of fields in each row.
+		pub columns: usize,
+		/// Every field back to back.
+		///
+		/// Records are not guaranteed to be UTF-8, so this is bytes.
+		pub data: Vec<u8>,
+		/// Offsets into `data`. Cell `i` is `offsets[i]..offsets[i + 1]`,
+		/// where `i` is `r * columns + c`.
+		pub offsets: Vec<u32>,
+	}
+
+	/// How often record lookups were already in the record cache.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+	pub struct RecordCacheStats {
+		pub ver_hits: u64,
+		pub ver_misses: u64,
+		pub desc_hits: u64,
+		pub desc_misses: u64,
+	}
+
 	unsafe extern "C++" {
 		include!("oma-apt/apt-pkg-c/package.h");
 		include!("oma-apt/apt-pkg-c/records.h");
 		type Records;
+		type RecordEntry;
 		type VersionFile = crate::raw::package::raw::VersionFile;
 		type DescriptionFile = crate::raw::package::raw::DescriptionFile;
 		type PackageFile = crate::raw::package::raw::PackageFile;
 
-		pub fn ver_file_lookup(self: &Records, ver_file: &VersionFile);
-		pub fn desc_file_lookup(self: &Records, desc_file: &DescriptionFile);
+		/// Return the record of a version file.
+		///
+		/// The record is copied out of the package file once, when it isn't
+		/// already cached. Fields borrowed from it stay valid for as long as
+		/// the record is held, even after other lookups.
+		///
+		/// The descriptions, filename and hashes are read from the package
+		/// file the first time they are asked for, and return an error once
+		/// the Cache is gone.
+		///
+		/// Returns an error if the record can't be read.
+		pub fn ver_record(self: &Records, ver_file: &VersionFile)
+			-> Result<SharedPtr<RecordEntry>>;
+
+		/// Return the record of a description file.
+		pub fn desc_record(
+			self: &Records,
+			desc_file: &DescriptionFile,
+		) -> Result<SharedPtr<RecordEntry>>;
+
+		pub fn ver_file_lookup(self: &Records, ver_file: &VersionFile) -> Result<()>;
+		pub fn desc_file_lookup(self: &Records, desc_file: &DescriptionFile) -> Result<()>;
+
+		/// Set how many version records, and how many description records,
+		/// are kept parsed. The default is 16 of each.
+		pub fn set_cache_size(self: &Records, size: usize);
+
+		/// Hits and misses of the record cache since the Records were created.
+		pub fn cache_stats(self: &Records) -> RecordCacheStats;
 
 		pub fn long_desc(self: &Records) -> Result<String>;
 		pub fn short_desc(self: &Records) -> Result<String>;
@@ -19,5 +74,89 @@ pub mod raw {
 		pub fn hash_find(self: &Records, hash_type: String) -> Result<String>;
 
 		pub fn ver_uri(self: &Records, pkg_file: &PackageFile) -> Result<String>;
+
+		// RecordEntry Declarations
+		/// The value of a field. Returns an error if it's empty.
+		pub fn field<'a>(self: &'a RecordEntry, key: &str) -> Result<&'a str>;
+		/// The translated long description.
+		pub fn long_description(self: &RecordEntry) -> Result<&str>;
+		/// The translated short description.
+		pub fn short_description(self: &RecordEntry) -> Result<&str>;
+		/// The name of the file in the archive.
+		pub fn filename(self: &RecordEntry) -> Result<&str>;
+		/// Find a hash by type, such as "sha256".
+		pub fn hash<'a>(self: &'a RecordEntry, hash_type: &str) -> Result<&'a str>;
+		/// The number of fields in the record.
+		pub fn field_count(self: &RecordEntry) -> u32;
+		pub fn key_at(self: &RecordEntry, index: u32) -> Result<&str>;
+		pub fn value_at(self: &RecordEntry, index: u32) -> Result<&str>;
+
+		/// Get record fields for many Version IDs at once.
+		///
+		/// Each package file is read front to back once, rather than seeking
+		/// for every version.
+		/// Returns an error if a Version ID is not in the cache,
+		/// or if a record can't be read.
+		pub fn bulk_fields(self: &Records, ver_ids: &[u32], fields: &[&str])
+			-> Result<RecordTable>;
+
+		/// Like [`Records::bulk_fields`], but the records are read on many
+		/// threads. Each thread has its own record parser over the same cache.
+		///
+		/// `threads` of `0` uses one thread per core.
+		/// Rows are in the same order as `ver_ids`.
+		/// Errors from every thread are returned once they have all stopped.
+		pub fn parallel_fields(
+			self: &Records,
+			ver_ids: &[u32],
+			fields: &[&str],
+			threads: usize,
+		) -> Result<RecordTable>;
+	}
+
+	extern "Rust" {
+		/// Called on c++ to append a field to the table in one copy.
+		fn extend_data(table: &mut RecordTable, field: &[u8]);
+	}
+}
+
+fn extend_data(table: &mut raw::RecordTable, field: &[u8]) { table.data.extend_from_slice(field); }
+
+impl raw::RecordEntry {
+	/// Iterate every key and value in the record, in order.
+	pub fn fields(&self) -> impl Iterator<Item = (&str, &str)> {
+		(0..self.field_count())
+			.filter_map(|index| Some((self.key_at(index).ok()?, self.value_at(index).ok()?)))
+	}
+}
+
+impl raw::RecordTable {
+	/// The number of rows in the table.
+	pub fn len(&self) -> usize {
+		match self.columns {
+			0 => 0,
+			columns => (self.offsets.len() - 1) / columns,
+		}
+	}
+
+	pub fn is_empty(&self) -> bool { self.len() == 0 }
+
+	/// The raw bytes of a field, None if it's empty.
+	pub fn get_bytes(&self, row: usize, col: usize) -> Option<&[u8]> {
+		if col >= self.columns {
+			return None;
+		}
+		let cell = row * self.columns + col;
+		let start = *self.offsets.get(cell)? as usize;
+		let end = *self.offsets.get(cell + 1)? as usize;
+		match start == end {
+			true => None,
+			false => Some(&self.data[start..end]),
+		}
+	}
+
+	/// A field, None if it's empty or not UTF-8.
+	pub fn get(&self, row: usize, col: usize) -> Option<&str> {
+		std::str::from_utf8(self.get_bytes(row, col)?).ok()
 	}
 }
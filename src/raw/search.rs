@@ -0,0 +1,65 @@
+//! Contains a full text search index over package names and descriptions.
+//!
+//! The index is a file that is memory mapped when it's opened.
+//! It's rebuilt from the records only when the package lists change,
+//! so a search doesn't need to read a single record.
+
+/// This module contains the bindings and structs shared with c++
+#[cxx::bridge]
+pub mod raw {
+	/// Bits set in [`SearchHit::fields`].
+	#[repr(u8)]
+	pub enum SearchField {
+		/// The package name.
+		Name = 1,
+		/// The short description.
+		ShortDesc = 2,
+		/// The long description.
+		LongDesc = 4,
+	}
+
+	/// A package that has every term of a search.
+	#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+	pub struct SearchHit {
+		/// The ID of the package.
+		pub pkg_id: u32,
+		/// [`SearchField`] bits of where the terms were found.
+		pub fields: u8,
+	}
+
+	unsafe extern "C++" {
+		include!("oma-apt/apt-pkg-c/cache.h");
+		include!("oma-apt/apt-pkg-c/util.h");
+		include!("oma-apt/apt-pkg-c/search.h");
+
+		type Cache = crate::raw::cache::raw::Cache;
+
+		/// A search index mapped into memory.
+		type SearchIndex;
+
+		/// Map the search index at `path`.
+		///
+		/// The index is written first if it doesn't exist, or if the
+		/// package lists or description languages have changed since it
+		/// was written.
+		pub fn open_search_index(cache: &Cache, path: &str) -> Result<UniquePtr<SearchIndex>>;
+
+		/// Return every package that has all the words in a query.
+		///
+		/// Words are matched without case, against the start of any word,
+		/// and anywhere in a word of a package name.
+		/// Name matches come first, then short description matches.
+		pub fn search(self: &SearchIndex, query: &str) -> Vec<SearchHit>;
+
+		/// True if the index had to be written when it was opened.
+		pub fn rebuilt(self: &SearchIndex) -> bool;
+
+		/// The number of distinct words in the index.
+		pub fn term_count(self: &SearchIndex) -> u32;
+	}
+}
+
+impl raw::SearchHit {
+	/// True if a term was found in this field.
+	pub fn matched(&self, field: raw::SearchField) -> bool { self.fields & field.repr != 0 }
+}
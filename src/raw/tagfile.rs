@@ -0,0 +1,52 @@
+//! Contains a TagFile reader backed by apt.
+//!
+//! Unlike [`crate::tagfile`], this can read compressed files such as
+//! `/var/lib/apt/lists/*_Packages.lz4`, and the control file of a `.deb`.
+
+/// This module contains the bindings and structs shared with c++
+#[cxx::bridge]
+pub mod raw {
+	unsafe extern "C++" {
+		include!("oma-apt/apt-pkg-c/util.h");
+		include!("oma-apt/apt-pkg-c/tagfile.h");
+
+		/// A TagFile read one section at a time.
+		///
+		/// Fields borrow from the current section,
+		/// so they can't be held across a call to `step`.
+		type TagFile;
+
+		/// Open a TagFile. The compressor is detected from the extension.
+		pub fn open_tagfile(path: &str) -> Result<UniquePtr<TagFile>>;
+
+		/// Open the control file of a `.deb`. It has one section.
+		pub fn open_deb_control(path: &str) -> Result<UniquePtr<TagFile>>;
+
+		/// Move to the next section. Returns false at the end of the file.
+		pub fn step(self: Pin<&mut TagFile>) -> Result<bool>;
+
+		/// The value of a field in the current section.
+		/// Returns an error if it's empty.
+		pub fn find<'a>(self: &'a TagFile, key: &str) -> Result<&'a str>;
+
+		/// The number of fields in the current section.
+		pub fn count(self: &TagFile) -> Result<u32>;
+
+		pub fn key_at(self: &TagFile, index: u32) -> Result<&str>;
+		pub fn value_at(self: &TagFile, index: u32) -> Result<&str>;
+
+		/// The raw text of the current section.
+		pub fn section_text(self: &TagFile) -> Result<&str>;
+
+		/// The offset of the current section in the decompressed file.
+		pub fn offset(self: &TagFile) -> u64;
+	}
+}
+
+impl raw::TagFile {
+	/// Iterate every key and value in the current section, in order.
+	pub fn fields(&self) -> impl Iterator<Item = (&str, &str)> {
+		(0..self.count().unwrap_or(0))
+			.filter_map(|index| Some((self.key_at(index).ok()?, self.value_at(index).ok()?)))
+	}
+}
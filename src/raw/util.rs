@@ -15,6 +15,20 @@ pub mod raw {
 		/// use [`crate::util::cmp_versions`] instead.
 		pub fn cmp_versions(ver1: String, ver2: String) -> i32;
 
+		/// Sort versions from lowest to highest in one call.
+		/// Equal versions keep their order.
+		pub fn sort_versions(versions: &mut [String]);
+
+		/// Return the index of the highest version.
+		/// Returns an error if there are no versions.
+		pub fn max_version(versions: &[&str]) -> Result<usize>;
+
+		/// Return the index of every version that satisfies `op ver`.
+		///
+		/// `op` is written like in a dependency, such as `>=`.
+		/// Returns an error if it isn't one apt knows.
+		pub fn filter_satisfying(versions: &[&str], op: &str, ver: &str) -> Result<Vec<usize>>;
+
 		/// Return an APT-styled progress bar (`[####..]`).
 		pub fn get_apt_progress_string(percent: f32, output_width: u32) -> String;
 
@@ -152,41 +152,421 @@ impl TagSection {
 ///   objects if there was no issue parsing the file, and the [`Err`] variant if
 ///   there was.
 pub fn parse_tagfile(content: &str) -> Result<Vec<TagSection>, ParserError> {
-	let mut sections = vec![];
-	let section_strings = content.split("\n\n");
+	parse_chunk(content, 1)
+}
 
-	for (iter, section) in section_strings.clone().enumerate() {
-		// If this section is empty (i.e. more than one empty line was placed between
-		// each section), then ignore this section.
-		if section.is_empty() || section.chars().all(|c| c == '\n') {
-			break;
+/// Like [`parse_tagfile`], but the file is split into chunks at section
+/// boundaries and the chunks are parsed on `threads` threads.
+///
+/// Sections are in the same order, and errors are the same, as
+/// [`parse_tagfile`]. `threads` of `0` uses one thread per core.
+pub fn parse_tagfile_parallel(
+	content: &str,
+	threads: usize,
+) -> Result<Vec<TagSection>, ParserError> {
+	let threads = match threads {
+		0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+		threads => threads,
+	};
+
+	// Split roughly evenly, moving each split forward to the next blank line.
+	let bytes = content.as_bytes();
+	let mut chunks = vec![];
+	let mut start = 0;
+	for index in 1..threads {
+		let target = bytes.len() * index / threads;
+		if target < start {
+			continue;
 		}
+		match swar::find_blank_line(&bytes[target..]) {
+			Some(newline) => {
+				let end = target + newline + 2;
+				chunks.push(&content[start..end]);
+				start = end;
+			},
+			None => break,
+		}
+	}
+	chunks.push(&content[start..]);
+
+	// Line numbers are counted from the start of each chunk,
+	// and moved to the start of the file when the chunks are joined.
+	let results: Vec<_> = std::thread::scope(|scope| {
+		let handles: Vec<_> = chunks
+			.iter()
+			.map(|chunk| {
+				scope.spawn(move || (parse_chunk(chunk, 1), swar::count(chunk.as_bytes(), b'\n')))
+			})
+			.collect();
+
+		handles
+			.into_iter()
+			.map(|handle| handle.join().unwrap())
+			.collect()
+	});
 
-		match TagSection::new(section) {
-			Ok(section) => sections.push(section),
+	let mut sections = vec![];
+	let mut lines_before = 0;
+	for (result, lines) in results {
+		match result {
+			Ok(chunk) => sections.extend(chunk),
 			Err(mut err) => {
-				// If an error line was provided, add the number of lines in the sections before
-				// this one. Otherwise no line was specified, and we'll just specify the number
-				// of lines in the section before this one so we know which section the line is
-				// in.
-				let mut line_count = 0;
-
-				for _ in 0..iter {
-					// Add one for the line separation between each section.
-					line_count += 1;
-
-					// Add the line count in this section.
-					line_count += section_strings.clone().count();
+				err.line = err.line.map(|line| line + lines_before);
+				return Err(err);
+			},
+		}
+		lines_before += lines;
+	}
+
+	Ok(sections)
+}
+
+/// Parse the sections of a TagFile, or part of one that starts on a section.
+/// `line` is the line number `content` starts on.
+fn parse_chunk(content: &str, mut line: usize) -> Result<Vec<TagSection>, ParserError> {
+	let mut sections = vec![];
+
+	for section in content.split("\n\n") {
+		// More than one empty line can be between sections.
+		let trimmed = section.trim_start_matches('\n');
+		line += section.len() - trimmed.len();
+
+		if !trimmed.is_empty() {
+			match TagSection::new(trimmed) {
+				Ok(section) => sections.push(section),
+				Err(mut err) => {
+					// Section errors are counted from the first line of the section.
+					err.line = Some(line + err.line.unwrap_or(1) - 1);
+					return Err(err);
+				},
+			}
+		}
+
+		// The lines of this section, and the blank line after it.
+		line += swar::count(trimmed.as_bytes(), b'\n') + 2;
+	}
+
+	Ok(sections)
+}
+
+/// Word at a time byte search, so finding boundaries doesn't go byte by byte.
+mod swar {
+	const LO: u64 = 0x0101_0101_0101_0101;
+	const HI: u64 = 0x8080_8080_8080_8080;
+	const LOW7: u64 = 0x7f7f_7f7f_7f7f_7f7f;
+
+	/// Set the high bit of every byte in `word` equal to `byte`, exactly.
+	#[inline]
+	fn matches(word: u64, byte: u8) -> u64 {
+		let x = word ^ (LO * byte as u64);
+		!(((x & LOW7) + LOW7) | x) & HI
+	}
+
+	#[inline]
+	fn word(chunk: &[u8]) -> u64 { u64::from_le_bytes(chunk.try_into().unwrap()) }
+
+	/// Find the first `byte` in `haystack`.
+	pub fn find(haystack: &[u8], byte: u8) -> Option<usize> {
+		let mut chunks = haystack.chunks_exact(8);
+		for (index, chunk) in chunks.by_ref().enumerate() {
+			let found = matches(word(chunk), byte);
+			if found != 0 {
+				return Some(index * 8 + found.trailing_zeros() as usize / 8);
+			}
+		}
+		let rest = chunks.remainder();
+		let offset = haystack.len() - rest.len();
+		rest.iter().position(|b| *b == byte).map(|pos| offset + pos)
+	}
+
+	/// Count every `byte` in `haystack`.
+	pub fn count(haystack: &[u8], byte: u8) -> usize {
+		let mut chunks = haystack.chunks_exact(8);
+		let mut total = 0;
+		for chunk in chunks.by_ref() {
+			total += matches(word(chunk), byte).count_ones() as usize;
+		}
+		total + chunks.remainder().iter().filter(|b| **b == byte).count()
+	}
+
+	/// Find the first blank line, returning the index of the newline that
+	/// ends the line before it.
+	pub fn find_blank_line(haystack: &[u8]) -> Option<usize> {
+		let mut pos = 0;
+		while let Some(index) = find(&haystack[pos..], b'\n') {
+			let newline = pos + index;
+			if haystack.get(newline + 1) == Some(&b'\n') {
+				return Some(newline);
+			}
+			pos = newline + 1;
+		}
+		None
+	}
+}
+
+/// A section of a TagFile whose keys and values borrow from the input.
+///
+/// Values are the same as in a [`TagSection`], except an empty value is
+/// `""`. Comment lines inside a multi-line value are kept in the value.
+#[derive(Debug)]
+pub struct TagSectionRef<'a> {
+	text: &'a str,
+	line: usize,
+	fields: Vec<(&'a str, &'a str)>,
+}
+
+impl<'a> TagSectionRef<'a> {
+	fn error(msg: &str, line: usize) -> Result<Self, ParserError> {
+		Err(ParserError {
+			msg: "E:".to_owned() + msg,
+			line: Some(line),
+		})
+	}
+
+	/// Parse a single section. `line` is the line number the section starts on.
+	fn parse(text: &'a str, line: usize) -> Result<Self, ParserError> {
+		let bytes = text.as_bytes();
+		let mut fields = vec![];
+
+		// The key, and where its value starts and ends in `text`.
+		let mut current: Option<(&'a str, usize, usize)> = None;
+
+		let mut pos = 0;
+		let mut line_number = line;
+		while pos < bytes.len() {
+			let end = swar::find(&bytes[pos..], b'\n').map_or(bytes.len(), |index| pos + index);
+			let current_line = &text[pos..end];
+
+			if current_line.starts_with(' ') || current_line.starts_with('\t') {
+				match current.as_mut() {
+					Some((_, _, value_end)) => *value_end = end,
+					None => {
+						return Self::error(
+							"No key defined for the currently indented line",
+							line_number,
+						)
+					},
+				}
+			} else if !current_line.starts_with('#') {
+				if let Some((key, start, end)) = current.take() {
+					fields.push((key, &text[start..end]));
 				}
 
-				if let Some(line) = err.line {
-					err.line = Some(line_count + line);
-				} else {
-					err.line = Some(line_count);
+				let colon = match current_line.find(':') {
+					Some(colon) => colon,
+					None => {
+						return Self::error("Line doesn't contain a ':' separator", line_number)
+					},
+				};
+
+				let mut start = pos + colon + 1;
+				if bytes.get(start) == Some(&b' ') {
+					start += 1;
 				}
-			},
+				current = Some((&current_line[..colon], start.min(end), end));
+			}
+
+			pos = end + 1;
+			line_number += 1;
+		}
+
+		if let Some((key, start, end)) = current {
+			fields.push((key, &text[start..end]));
 		}
+
+		Ok(Self { text, line, fields })
 	}
 
-	Ok(sections)
+	/// Get the value of the specified key.
+	pub fn get(&self, key: &str) -> Option<&'a str> {
+		self.fields.iter().find(|(k, _)| *k == key).map(|(_, v)| *v)
+	}
+
+	/// Iterate the keys and values in the order they are in the section.
+	pub fn fields(&self) -> impl Iterator<Item = (&'a str, &'a str)> + '_ {
+		self.fields.iter().copied()
+	}
+
+	/// The raw text of the section.
+	pub fn text(&self) -> &'a str { self.text }
+
+	/// The line number the section starts on.
+	pub fn line(&self) -> usize { self.line }
+}
+
+impl<'a> From<TagSectionRef<'a>> for TagSection {
+	fn from(section: TagSectionRef<'a>) -> Self {
+		TagSection {
+			data: section
+				.fields
+				.into_iter()
+				.map(|(key, value)| (key.to_string(), value.to_string()))
+				.collect(),
+		}
+	}
+}
+
+/// Turn a section of bytes into a [`TagSectionRef`].
+fn parse_section(bytes: &[u8], line: usize) -> Result<TagSectionRef<'_>, ParserError> {
+	match std::str::from_utf8(bytes) {
+		Ok(text) => TagSectionRef::parse(text, line),
+		Err(err) => Err(ParserError {
+			msg: format!("E:Section is not valid UTF-8: {err}"),
+			line: Some(line + swar::count(&bytes[..err.valid_up_to()], b'\n')),
+		}),
+	}
+}
+
+/// An iterator of the sections in a TagFile that is already in memory,
+/// such as a mmap of a Packages file.
+///
+/// Sections borrow from the input, nothing is copied.
+pub struct TagSections<'a> {
+	content: &'a [u8],
+	pos: usize,
+	line: usize,
+}
+
+impl<'a> TagSections<'a> {
+	pub fn new(content: &'a [u8]) -> Self {
+		TagSections {
+			content,
+			pos: 0,
+			line: 1,
+		}
+	}
+}
+
+impl<'a> Iterator for TagSections<'a> {
+	type Item = Result<TagSectionRef<'a>, ParserError>;
+
+	fn next(&mut self) -> Option<Self::Item> {
+		// Any number of blank lines can separate sections.
+		while self.content.get(self.pos) == Some(&b'\n') {
+			self.pos += 1;
+			self.line += 1;
+		}
+		if self.pos >= self.content.len() {
+			return None;
+		}
+
+		let rest = &self.content[self.pos..];
+		let len = swar::find_blank_line(rest)
+			.unwrap_or_else(|| rest.len() - usize::from(rest.ends_with(b"\n")));
+
+		let line = self.line;
+		self.line += swar::count(&rest[..len], b'\n');
+		self.pos += len;
+
+		Some(parse_section(&rest[..len], line))
+	}
+}
+
+/// Parse the sections of a TagFile out of a reader, one at a time.
+///
+/// Only the section being parsed is kept in memory,
+/// so memory use depends on the largest section, not the size of the file.
+///
+/// ```no_run
+/// use std::fs::File;
+///
+/// use oma_apt::tagfile::TagReader;
+///
+/// let file = File::open("/var/lib/dpkg/status").unwrap();
+/// let mut reader = TagReader::new(file);
+///
+/// while let Some(section) = reader.next_section() {
+///     let section = section.unwrap();
+///     println!("{}", section.get("Package").unwrap());
+/// }
+/// ```
+pub struct TagReader<R> {
+	reader: R,
+	buf: Vec<u8>,
+	/// Where the next section starts in `buf`.
+	start: usize,
+	/// How far past `start` has been searched for a blank line.
+	searched: usize,
+	line: usize,
+	eof: bool,
+}
+
+impl<R: std::io::Read> TagReader<R> {
+	/// How much to read at a time.
+	const CHUNK: usize = 64 * 1024;
+
+	pub fn new(reader: R) -> Self {
+		TagReader {
+			reader,
+			buf: vec![],
+			start: 0,
+			searched: 0,
+			line: 1,
+			eof: false,
+		}
+	}
+
+	/// Read another chunk into the buffer,
+	/// dropping what has already been parsed.
+	fn fill(&mut self) -> Result<(), ParserError> {
+		self.buf.drain(..self.start);
+		self.start = 0;
+
+		let len = self.buf.len();
+		self.buf.resize(len + Self::CHUNK, 0);
+		loop {
+			match self.reader.read(&mut self.buf[len..]) {
+				Ok(read) => {
+					self.buf.truncate(len + read);
+					self.eof = read == 0;
+					return Ok(());
+				},
+				Err(err) if err.kind() == std::io::ErrorKind::Interrupted => continue,
+				Err(err) => {
+					self.buf.truncate(len);
+					return Err(ParserError {
+						msg: format!("E:{err}"),
+						line: Some(self.line),
+					});
+				},
+			}
+		}
+	}
+
+	/// Parse the next section, or `None` at the end of the input.
+	pub fn next_section(&mut self) -> Option<Result<TagSectionRef<'_>, ParserError>> {
+		let len = loop {
+			// Any number of blank lines can separate sections.
+			while self.buf.get(self.start) == Some(&b'\n') {
+				self.start += 1;
+				self.line += 1;
+			}
+
+			let rest = &self.buf[self.start..];
+			if let Some(len) = swar::find_blank_line(&rest[self.searched.min(rest.len())..]) {
+				break self.searched.min(rest.len()) + len;
+			}
+
+			if self.eof {
+				if rest.is_empty() {
+					return None;
+				}
+				break rest.len() - usize::from(rest.ends_with(b"\n"));
+			}
+
+			// The last byte might be the first newline of a blank line.
+			self.searched = rest.len().saturating_sub(1);
+			if let Err(err) = self.fill() {
+				return Some(Err(err));
+			}
+		};
+
+		let start = self.start;
+		let line = self.line;
+		self.line += swar::count(&self.buf[start..start + len], b'\n');
+		self.start += len;
+		self.searched = 0;
+
+		Some(parse_section(&self.buf[start..start + len], line))
+	}
 }
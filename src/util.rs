@@ -54,6 +54,142 @@ pub fn cmp_versions(ver1: &str, ver2: &str) -> Ordering {
 	}
 }
 
+/// Sorts versions from lowest to highest, the same as [`cmp_versions`].
+///
+/// Every comparison happens in one call into apt.
+/// Equal versions keep their order.
+///
+/// # Examples
+/// ```
+/// use oma_apt::util::sort_versions;
+///
+/// let mut versions = vec!["1.0".to_string(), "1.0~rc1".to_string(), "0.9".to_string()];
+/// sort_versions(&mut versions);
+///
+/// assert_eq!(versions, ["0.9", "1.0~rc1", "1.0"]);
+/// ```
+pub fn sort_versions(versions: &mut [String]) { raw::sort_versions(versions) }
+
+/// Returns the highest version, or None if there are none.
+///
+/// If the highest version is there more than once, the first is returned.
+pub fn max_version<'a>(versions: &[&'a str]) -> Option<&'a str> {
+	Some(versions[raw::max_version(versions).ok()?])
+}
+
+/// Returns every version that satisfies `op ver`, in the same order.
+///
+/// `op` is written like in a dependency: `<<`, `<=`, `=`, `!=`, `>=` or `>>`.
+///
+/// # Examples
+/// ```
+/// use oma_apt::util::filter_satisfying;
+///
+/// let versions = ["1.0", "2.0~rc1", "2.0", "2:0.1"];
+/// let newer = filter_satisfying(&versions, ">=", "2.0").unwrap();
+///
+/// assert_eq!(newer, ["2.0", "2:0.1"]);
+/// ```
+pub fn filter_satisfying<'a>(
+	versions: &[&'a str],
+	op: &str,
+	ver: &str,
+) -> Result<Vec<&'a str>, Exception> {
+	Ok(raw::filter_satisfying(versions, op, ver)?
+		.into_iter()
+		.map(|index| versions[index])
+		.collect())
+}
+
+/// Turn a version into a key that sorts like the version.
+///
+/// Comparing two keys as bytes gives the same order as [`cmp_versions`],
+/// so versions can be sorted without calling into apt.
+///
+/// # Examples
+/// ```
+/// use oma_apt::util::version_key;
+///
+/// assert!(version_key("1.0~rc1") < version_key("1.0"));
+/// assert!(version_key("1:0.9") > version_key("2.0"));
+/// assert_eq!(version_key("1.0-0"), version_key("1.0"));
+/// ```
+pub fn version_key(version: &str) -> Vec<u8> {
+	let mut key = Vec::with_capacity(version.len() + 8);
+	push_version_key(version, &mut key);
+	key
+}
+
+// Bytes of a version key. A fragment is alternating runs of non digits and
+// numbers, like apt compares them.
+//
+// Each run ends with `RUN_END` so that a shorter run sorts after `~` but
+// before anything else. Every number, even an empty one, is its length
+// without leading zeros and then its digits. A fragment ends with
+// `RUN_END`, as if it went on with empty runs.
+const TILDE: u8 = 0x01;
+const RUN_END: u8 = 0x02;
+/// Non ASCII bytes sort after letters. This prefixes them.
+const HIGH: u8 = 0x7B;
+/// Other characters sort after everything else. They're offset by this.
+const OTHER: u8 = 0x80;
+
+/// Append the key of a version to `key`.
+pub(crate) fn push_version_key(version: &str, key: &mut Vec<u8>) {
+	let bytes = version.as_bytes();
+
+	// A missing epoch is epoch 0.
+	let (epoch, rest) = match bytes.iter().position(|b| *b == b':') {
+		Some(colon) => (&bytes[..colon], &bytes[colon + 1..]),
+		None => (&b""[..], bytes),
+	};
+
+	// A missing revision is the same as revision 0.
+	let (upstream, revision) = match rest.iter().rposition(|b| *b == b'-') {
+		Some(dash) => (&rest[..dash], &rest[dash + 1..]),
+		None => (rest, &b""[..]),
+	};
+
+	push_fragment(epoch, key);
+	push_fragment(upstream, key);
+	push_fragment(revision, key);
+}
+
+fn push_fragment(mut fragment: &[u8], key: &mut Vec<u8>) {
+	loop {
+		let run = fragment
+			.iter()
+			.position(u8::is_ascii_digit)
+			.unwrap_or(fragment.len());
+		for byte in &fragment[..run] {
+			match byte {
+				b'~' => key.push(TILDE),
+				b if b.is_ascii_alphabetic() => key.push(*b),
+				b if !b.is_ascii() => key.extend_from_slice(&[HIGH, *b]),
+				b => key.push(OTHER + b),
+			}
+		}
+		key.push(RUN_END);
+		fragment = &fragment[run..];
+
+		let digits = fragment
+			.iter()
+			.position(|b| !b.is_ascii_digit())
+			.unwrap_or(fragment.len());
+		let number = &fragment[..digits];
+		let zeros = number.iter().take_while(|b| **b == b'0').count();
+		let number = &number[zeros..];
+		key.push(number.len().min(u8::MAX as usize) as u8);
+		key.extend_from_slice(number);
+		fragment = &fragment[digits..];
+
+		if fragment.is_empty() {
+			key.push(RUN_END);
+			return;
+		}
+	}
+}
+
 /// Disk Space that `apt` will use for a transaction.
 pub enum DiskSpace {
 	/// Additional Disk Space required.
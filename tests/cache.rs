@@ -1,10 +1,12 @@
 mod cache {
 	use std::collections::HashMap;
 	use std::fmt::Write as _;
+	use std::time::Duration;
 
 	use oma_apt::cache::*;
 	use oma_apt::new_cache;
 	use oma_apt::package::DepType;
+	use oma_apt::raw::progress::{Budget, BudgetError};
 	use oma_apt::util::*;
 
 	#[test]
@@ -39,6 +41,89 @@ mod cache {
 		}
 	}
 
+	#[test]
+	fn handles() {
+		use oma_apt::raw::handle::raw::*;
+
+		let cache = new_cache!().unwrap();
+
+		assert!(find_pkg_handle(&cache, "this-package-doesnt-exist")
+			.unwrap()
+			.end());
+		let handle = find_pkg_handle(&cache, "apt").unwrap();
+		assert_eq!(pkg_name(&cache, handle).unwrap(), "apt");
+
+		let pkg = cache.get("apt").unwrap();
+		assert_eq!(pkg_id(&cache, handle).unwrap(), pkg.id());
+
+		// Both surfaces should walk the same versions and dependencies.
+		let versions: Vec<_> = handle
+			.versions(&cache)
+			.unwrap()
+			.collect::<Result<_, _>>()
+			.unwrap();
+		assert_eq!(versions.len(), pkg.versions().count());
+		for (ver, version) in versions.into_iter().zip(pkg.versions()) {
+			assert_eq!(ver_str(&cache, ver).unwrap(), version.version());
+			let parent = ver_parent_pkg(&cache, ver).unwrap();
+			assert_eq!(pkg_name(&cache, parent).unwrap(), "apt");
+
+			let mut targets = vec![];
+			for dep in ver.depends(&cache).unwrap() {
+				let target = dep_target_pkg(&cache, dep.unwrap()).unwrap();
+				targets.push(pkg_name(&cache, target).unwrap());
+			}
+
+			let mut expected = vec![];
+			for dep in version.depends().into_iter().flatten() {
+				expected.push(dep.target_pkg().name().to_string());
+			}
+			assert_eq!(targets, expected);
+		}
+
+		// Every reverse dependency should point back at apt.
+		for dep in handle.rev_depends(&cache).unwrap() {
+			let dep = dep.unwrap();
+			assert!(dep.reverse);
+			assert_eq!(dep_target_pkg(&cache, dep).unwrap(), handle);
+		}
+
+		// End and forged handles are errors instead of reads past the cache.
+		let end = find_pkg_handle(&cache, "this-package-doesnt-exist").unwrap();
+		assert!(pkg_name(&cache, end).is_err());
+		assert!(pkg_name(&cache, PkgHandle { offset: u32::MAX }).is_err());
+		assert!(ver_str(&cache, VerHandle { offset: u32::MAX }).is_err());
+	}
+
+	#[test]
+	fn snapshot() {
+		let cache = new_cache!().unwrap();
+		let snapshot = cache.snapshot().unwrap();
+
+		// The snapshot should be in the same order as the raw packages.
+		let mut rows = 0;
+		for (row, pkg) in cache.raw_pkgs().unwrap().enumerate() {
+			assert_eq!(snapshot.ids[row], pkg.id());
+			assert_eq!(snapshot.name(row), pkg.name());
+			assert_eq!(snapshot.arch(row), pkg.arch());
+			assert_eq!(snapshot.current_state[row], pkg.current_state());
+			assert_eq!(snapshot.is_essential(row), pkg.is_essential());
+			assert_eq!(snapshot.has_versions(row), pkg.has_versions());
+			assert_eq!(
+				snapshot.current_version(row),
+				pkg.current_version().map(|ver| ver.id())
+			);
+			rows += 1;
+		}
+		assert_eq!(snapshot.len(), rows);
+
+		// Packages by ID should come back in the order asked for.
+		let ids: Vec<u32> = snapshot.ids.iter().rev().take(10).copied().collect();
+		let pkgs = cache.pkgs_by_id(&ids).unwrap();
+		assert_eq!(pkgs.iter().map(|pkg| pkg.id()).collect::<Vec<_>>(), ids);
+		assert!(cache.pkgs_by_id(&[u32::MAX]).is_err());
+	}
+
 	#[test]
 	fn with_debs() {
 		let cache = new_cache!(&[
@@ -492,6 +577,109 @@ mod cache {
 		assert!(cache.resolve(false).is_err());
 	}
 
+	#[test]
+	fn open_profile() {
+		assert!(new_cache!().unwrap().open_profile().is_none());
+
+		let debs: Vec<String> = Vec::new();
+		let cache = Cache::new_profiled(&debs).unwrap();
+		let profile = cache.open_profile().unwrap();
+		println!("{profile}");
+
+		assert!(!profile.reason.is_empty());
+		assert!(profile.pkgcache_size > 0);
+		assert!(profile.index_files > 0);
+		assert!(profile.index_files_parsed <= profile.index_files);
+		if profile.reused {
+			assert_eq!(profile.index_files_parsed, 0);
+		}
+		assert!(profile.total() >= Duration::from_micros(profile.caches_micros));
+		assert!(cache.get("apt").is_some());
+
+		// A pkgcache.bin that was just written is up to date.
+		if profile.pkgcache_written {
+			let cache = Cache::new_profiled(&debs).unwrap();
+			let profile = cache.open_profile().unwrap();
+			assert!(profile.reused);
+			assert_eq!(profile.index_files_parsed, 0);
+		}
+
+		// Local debs can't be in pkgcache.bin.
+		let cache = Cache::new_profiled(&["tests/files/cache/apt.deb"]).unwrap();
+		let profile = cache.open_profile().unwrap();
+		assert!(!profile.reused);
+		assert!(profile.index_files_parsed > 0);
+		// The sources.list files were read while adding the deb.
+		assert_eq!(profile.sources_micros, 0);
+		assert!(cache.get("apt").is_some());
+	}
+
+	#[test]
+	fn budgeted_resolution() {
+		let cache = new_cache!().unwrap();
+
+		let pkg = cache.get("zeek").unwrap();
+		pkg.mark_install(false, true);
+		pkg.protect();
+		let before = cache.depcache().state_snapshot();
+
+		// A budget that has already run out stops before anything changes.
+		let spent = Budget::new().timeout(Duration::ZERO);
+		assert!(matches!(
+			cache.resolve_budgeted(false, &spent),
+			Err(BudgetError::Exceeded)
+		));
+		assert_eq!(cache.depcache().state_snapshot(), before);
+
+		assert!(matches!(
+			cache.upgrade_budgeted(&Upgrade::FullUpgrade, &spent),
+			Err(BudgetError::Exceeded)
+		));
+		assert_eq!(cache.depcache().state_snapshot(), before);
+
+		assert!(matches!(
+			cache.fix_broken_budgeted(&spent),
+			Err(BudgetError::Exceeded)
+		));
+		assert_eq!(cache.depcache().state_snapshot(), before);
+
+		// Cancelling a clone cancels the original.
+		let budget = Budget::new();
+		assert!(!budget.is_exceeded());
+		budget.clone().cancel();
+		assert!(budget.is_exceeded());
+
+		// With time to spare it's the same as resolve.
+		let budget = Budget::new().timeout(Duration::from_secs(600));
+		assert!(matches!(
+			cache.resolve_budgeted(false, &budget),
+			Err(BudgetError::Apt(_))
+		));
+	}
+
+	#[test]
+	fn resolve_with_stats() {
+		let cache = new_cache!().unwrap();
+
+		// `zeek` can't be resolved, but it's still measured.
+		let pkg = cache.get("zeek").unwrap();
+		pkg.mark_install(false, true);
+		pkg.protect();
+
+		let stats = cache.resolve_with_stats(false);
+		assert!(!stats.resolved);
+		assert!(!stats.error.is_empty());
+		assert!(stats.broken_before > 0);
+		assert!(stats.broken_after > 0);
+
+		// A clean cache has nothing to do.
+		let cache = new_cache!().unwrap();
+		let stats = cache.resolve_with_stats(false);
+		assert!(stats.resolved);
+		assert_eq!(stats.broken_after, 0);
+		assert_eq!((stats.kept, stats.removed, stats.installed), (0, 0, 0));
+	}
+
 	#[test]
 	fn depcache_clear() {
 		let cache = new_cache!().unwrap();
@@ -542,4 +730,75 @@ mod cache {
 			// println!("{pkg_file}");
 		}
 	}
+
+	#[test]
+	fn get_many() {
+		let cache = new_cache!().unwrap();
+		let pkgs = cache
+			.get_many(&["apt", "not-a-real-package", "dpkg"])
+			.unwrap();
+
+		assert_eq!(pkgs.len(), 3);
+		assert_eq!(pkgs[0].as_ref().unwrap().name(), "apt");
+		assert!(pkgs[1].is_none());
+		assert_eq!(pkgs[2].as_ref().unwrap().name(), "dpkg");
+	}
+
+	#[test]
+	fn name_index() {
+		let cache = new_cache!().unwrap();
+		let index = cache.name_index().unwrap();
+		let apt = cache.get("apt").unwrap();
+
+		assert!(index.find("apt").contains(&apt.id()));
+		assert_eq!(index.find(&apt.fullname(false)), vec![apt.id()]);
+		assert!(index.find("not-a-real-package").is_empty());
+
+		let prefix = index.prefix("apt");
+		assert!(prefix.contains(&apt.id()));
+		assert!(index.prefix("apt-").len() < prefix.len());
+
+		// Every glob match is also a prefix match.
+		let glob: Vec<u32> = cache.glob("apt*").unwrap().map(|pkg| pkg.id()).collect();
+		assert_eq!(glob, prefix);
+
+		for pkg in cache.glob("a?t").unwrap() {
+			assert_eq!(pkg.name().len(), 3);
+			assert!(pkg.name().starts_with('a') && pkg.name().ends_with('t'));
+		}
+		assert!(cache.glob("*").unwrap().count() >= cache.glob("*:amd64").unwrap().count());
+	}
+
+	#[test]
+	fn policy_table() {
+		let cache = new_cache!().unwrap();
+		let table = cache.policy_table().unwrap();
+
+		for pkg in cache.packages(&PackageSort::default()).unwrap().take(500) {
+			assert_eq!(
+				table.candidate(pkg.id()),
+				pkg.candidate().map(|ver| ver.id())
+			);
+			for ver in pkg.versions() {
+				assert_eq!(table.priority(ver.id()), Some(ver.priority()));
+			}
+		}
+
+		// Nothing changed, so the same table is returned.
+		assert!(std::rc::Rc::ptr_eq(&table, &cache.policy_table().unwrap()));
+
+		let pkg = cache
+			.packages(&PackageSort::default())
+			.unwrap()
+			.find(|pkg| pkg.versions().count() > 1 && pkg.candidate().is_some())
+			.unwrap();
+		let other = pkg
+			.versions()
+			.find(|ver| Some(ver.id()) != table.candidate(pkg.id()))
+			.unwrap();
+		other.set_candidate();
+
+		let table = cache.policy_table().unwrap();
+		assert_eq!(table.candidate(pkg.id()), Some(other.id()));
+	}
 }
@@ -73,4 +73,185 @@ mod depcache {
 			}
 		}
 	}
+
+	#[test]
+	fn state_snapshot() {
+		use oma_apt::raw::depcache::raw::StateFlag;
+
+		let cache = new_cache!().unwrap();
+		let pkg = cache.get("apt").unwrap();
+		pkg.mark_delete(true);
+
+		let states = cache.depcache().state_snapshot();
+		let state = states[pkg.id() as usize];
+		assert_eq!(state.is(StateFlag::Delete), pkg.marked_delete());
+		assert_eq!(state.is(StateFlag::Purge), pkg.marked_purge());
+		assert_eq!(state.is(StateFlag::Keep), pkg.marked_keep());
+		assert_eq!(
+			state.is(StateFlag::Garbage),
+			cache.depcache().is_garbage(&pkg)
+		);
+		assert_eq!(state.is(StateFlag::NowBroken), pkg.is_now_broken());
+		assert_eq!(state.candidate(), pkg.candidate().map(|ver| ver.id()));
+		assert!(state.is_changed());
+
+		let changes: Vec<_> = cache.get_changes(false).unwrap().collect();
+		assert!(changes.iter().any(|change| change.id() == pkg.id()));
+		assert_eq!(
+			changes.len(),
+			states.iter().filter(|state| state.is_changed()).count()
+		);
+	}
+
+	#[test]
+	fn journal() {
+		let cache = new_cache!().unwrap();
+		let depcache = cache.depcache();
+		depcache.reset_journal();
+		assert!(depcache.journal().is_empty());
+
+		let pkg = cache.get("apt").unwrap();
+		pkg.mark_delete(false);
+		assert_eq!(depcache.journal(), vec![pkg.id()]);
+		assert_eq!(depcache.changed_pkgs(), vec![pkg.id()]);
+
+		// Changing back stays in the journal, but isn't a change.
+		pkg.mark_keep();
+		assert_eq!(depcache.journal(), vec![pkg.id()]);
+		assert!(depcache.changed_pkgs().is_empty());
+		assert_eq!(cache.get_changes(false).unwrap().count(), 0);
+
+		depcache.reset_journal();
+		assert!(depcache.journal().is_empty());
+
+		// Upgrades mark many packages, all of them are seen.
+		cache.upgrade(&Upgrade::FullUpgrade).unwrap();
+		let mut changed = depcache.changed_pkgs();
+		let mut expected: Vec<u32> = depcache
+			.state_snapshot()
+			.iter()
+			.enumerate()
+			.filter(|(_, state)| state.is_changed())
+			.map(|(id, _)| id as u32)
+			.collect();
+		changed.sort_unstable();
+		expected.sort_unstable();
+		assert_eq!(changed, expected);
+		for id in &changed {
+			assert!(depcache.journal().contains(id));
+		}
+
+		// The packages are the same as the IDs, in the same order.
+		let packages: Vec<u32> = depcache
+			.changed_packages()
+			.iter()
+			.map(|pkg| pkg.id())
+			.collect();
+		assert_eq!(packages, depcache.changed_pkgs());
+
+		// They come in the same order as walking the cache.
+		let in_order: Vec<u32> = cache
+			.iter()
+			.map(|pkg| pkg.id())
+			.filter(|id| changed.binary_search(id).is_ok())
+			.collect();
+		assert_eq!(packages, in_order);
+	}
+
+	#[test]
+	fn checkpoint() {
+		let cache = new_cache!().unwrap();
+		let depcache = cache.depcache();
+		let before = depcache.state_snapshot();
+		let checkpoint = depcache.checkpoint().unwrap();
+
+		let pkg = cache.get("apt").unwrap();
+		pkg.mark_delete(true);
+		cache.upgrade(&Upgrade::FullUpgrade).unwrap();
+		assert!(pkg.marked_delete());
+
+		depcache.restore(&checkpoint).unwrap();
+		assert!(!pkg.marked_delete());
+		assert_eq!(depcache.state_snapshot(), before);
+		assert_eq!(depcache.delete_count(), 0);
+		assert_eq!(cache.get_changes(false).unwrap().count(), 0);
+
+		// A checkpoint can be restored more than once.
+		pkg.mark_delete(true);
+		depcache.restore(&checkpoint).unwrap();
+		assert!(!pkg.marked_delete());
+	}
+
+	#[test]
+	fn simulation() {
+		let cache = new_cache!().unwrap();
+		let names = ["apt", "dpkg", "bash"];
+		let ids: Vec<u32> = names
+			.iter()
+			.map(|name| cache.get(name).unwrap().id())
+			.collect();
+
+		// What the real DepCache says about removing each package.
+		let depcache = cache.depcache();
+		let checkpoint = depcache.checkpoint().unwrap();
+		let mut expected = vec![];
+		for name in names {
+			cache.get(name).unwrap().mark_delete(false);
+			expected.push((depcache.delete_count(), depcache.disk_size()));
+			depcache.restore(&checkpoint).unwrap();
+		}
+
+		// Every simulation is kept at once, none of them see the others.
+		let sims: Vec<_> = ids.iter().map(|_| cache.simulation().unwrap()).collect();
+		for (sim, id) in sims.iter().zip(&ids) {
+			sim.mark_delete(*id, false).unwrap();
+		}
+		let results: Vec<_> = sims
+			.iter()
+			.map(|sim| (sim.delete_count(), sim.disk_size()))
+			.collect();
+		assert_eq!(results, expected);
+
+		// The real DepCache is untouched, and a simulation can be reused.
+		assert_eq!(depcache.delete_count(), 0);
+		let sim = cache.simulation().unwrap();
+		sim.mark_delete(ids[0], false).unwrap();
+		sim.reset().unwrap();
+		assert_eq!(sim.delete_count(), 0);
+		assert!(sim.mark_install(u32::MAX, true).is_err());
+	}
+
+	#[test]
+	fn mark_many() {
+		let cache = new_cache!().unwrap();
+		let depcache = cache.depcache();
+		let pkgs: Vec<_> = ["apt", "dpkg"]
+			.iter()
+			.map(|name| cache.get(name).unwrap())
+			.collect();
+		let ids: Vec<u32> = pkgs.iter().map(|pkg| pkg.id()).collect();
+
+		let marked = depcache.mark_delete_many(&ids, false).unwrap();
+		assert_eq!(marked.len(), ids.len());
+		for (pkg, marked) in pkgs.iter().zip(marked) {
+			assert_eq!(marked, pkg.marked_delete());
+		}
+
+		let marked = depcache.mark_install_many(&ids, true, true).unwrap();
+		assert_eq!(marked.len(), ids.len());
+		for pkg in &pkgs {
+			assert!(!pkg.marked_delete());
+		}
+
+		depcache.mark_auto_many(&ids[..1], true).unwrap();
+		assert!(pkgs[0].is_auto_installed());
+		depcache.mark_auto_many(&ids[..1], false).unwrap();
+		assert!(!pkgs[0].is_auto_installed());
+
+		// Nothing is marked if an ID is bad.
+		assert!(depcache
+			.mark_delete_many(&[ids[0], u32::MAX], false)
+			.is_err());
+		assert!(!pkgs[0].marked_delete());
+	}
 }
@@ -0,0 +1,142 @@
+mod depgraph {
+	use std::collections::HashSet;
+
+	use oma_apt::new_cache;
+	use oma_apt::package::DepType;
+	use oma_apt::raw::depgraph::raw::ClosureQuery;
+
+	#[test]
+	fn forward() {
+		let cache = new_cache!().unwrap();
+		let graph = cache.dep_graph().unwrap();
+		let pkg = cache.get("apt").unwrap();
+
+		for version in pkg.versions() {
+			let edges = graph.depends(version.id());
+
+			// Rebuild the same view from the per version maps.
+			let mut expected = vec![];
+			for dep in version.depends().into_iter().flatten() {
+				expected.push((
+					dep.target_pkg().id(),
+					dep.dep_type(),
+					dep.compare_op(),
+					dep.target_ver().ok().map(str::to_string),
+				));
+			}
+
+			let mut found = vec![];
+			for edge in edges {
+				assert_eq!(graph.parents[edge], version.id());
+				found.push((
+					graph.targets[edge],
+					graph.dep_types[edge],
+					graph.is_or(edge),
+					graph.target_ver(edge).map(str::to_string),
+				));
+			}
+			assert_eq!(found, expected);
+		}
+	}
+
+	#[test]
+	fn or_groups() {
+		let cache = new_cache!().unwrap();
+		let graph = cache.dep_graph().unwrap();
+
+		for edge in 0..graph.len() {
+			let group = graph.or_group(edge);
+			assert!(group.contains(&edge));
+			// Only the last edge of a group is not Or'd.
+			for inner in group.clone() {
+				assert_eq!(graph.is_or(inner), inner + 1 != group.end);
+			}
+		}
+	}
+
+	#[test]
+	fn reverse() {
+		let cache = new_cache!().unwrap();
+		let graph = cache.dep_graph().unwrap();
+		let pkg = cache.get("apt").unwrap();
+
+		let mut expected: Vec<u32> = vec![];
+		for deps in pkg.rdepends_map().values() {
+			for dep in deps {
+				expected.push(dep.first().parent_ver().id());
+			}
+		}
+
+		let mut found: Vec<u32> = graph
+			.rdepends(pkg.id())
+			.iter()
+			.map(|edge| {
+				assert_eq!(graph.targets[*edge as usize], pkg.id());
+				graph.parents[*edge as usize]
+			})
+			.collect();
+
+		expected.sort_unstable();
+		found.sort_unstable();
+		assert_eq!(found, expected);
+
+		// IDs out of range are empty rather than a panic.
+		assert!(graph.rdepends(u32::MAX).is_empty());
+		assert!(graph.depends(u32::MAX).is_empty());
+	}
+
+	#[test]
+	fn closure() {
+		let cache = new_cache!().unwrap();
+		let pkg = cache.get("apt").unwrap();
+		let query = ClosureQuery::forward()
+			.dep_type(DepType::Depends)
+			.dep_type(DepType::PreDepends)
+			.provides(false);
+
+		// One step away is just the direct dependencies.
+		let direct = cache.closure(&[pkg.id()], &query.max_depth(1)).unwrap();
+		let mut expected = HashSet::new();
+		for version in pkg.versions() {
+			for dep in version.depends().into_iter().flatten() {
+				if matches!(dep.dep_type(), 1 | 2) && dep.target_pkg().id() != pkg.id() {
+					expected.insert(dep.target_pkg().id());
+				}
+			}
+		}
+		assert_eq!(
+			direct.get(0).iter().copied().collect::<HashSet<_>>(),
+			expected
+		);
+
+		// The full closure has every direct dependency, sorted.
+		let full = cache.closure(&[pkg.id()], &query).unwrap();
+		assert!(expected.iter().all(|id| full.get(0).contains(id)));
+		assert!(full.get(0).windows(2).all(|ids| ids[0] < ids[1]));
+
+		// Everything apt depends on has apt in its reverse closure.
+		let roots: Vec<u32> = full.get(0).to_vec();
+		let query = ClosureQuery::reverse()
+			.dep_type(DepType::Depends)
+			.dep_type(DepType::PreDepends)
+			.provides(false);
+		let reverse = cache.closure(&roots, &query).unwrap();
+		assert_eq!(reverse.len(), roots.len());
+		for (i, root) in roots.iter().enumerate() {
+			assert!(reverse.get(i).contains(&pkg.id()));
+
+			// Walking a root alone gives the same set as walking it in parallel.
+			if i < 4 {
+				let alone = cache.closure(&[*root], &query).unwrap();
+				assert_eq!(alone.get(0), reverse.get(i));
+			}
+		}
+
+		assert!(cache.closure(&[u32::MAX], &query).is_err());
+
+		// Depends and PreDepends are the default, a query without types is an error.
+		let default = cache.closure(&roots, &ClosureQuery::reverse().provides(false));
+		assert_eq!(default.unwrap().ids, reverse.ids);
+		assert!(cache.closure(&roots, &query.dep_types(&[])).is_err());
+	}
+}
@@ -32,4 +32,209 @@ mod records {
 		// This should be the same as what the Hash accessors will give.
 		assert_eq!(cand.get_record("SHA256"), cand.sha256());
 	}
+
+	#[test]
+	fn bulk_fields() {
+		let cache = new_cache!().unwrap();
+		let fields = [
+			RecordField::Maintainer,
+			RecordField::Homepage,
+			"SHA256",
+			RecordField::Version,
+		];
+
+		let pkgs: Vec<_> = cache.iter().take(1000).collect();
+		let versions: Vec<_> = pkgs.iter().filter_map(|pkg| pkg.candidate()).collect();
+		let ids: Vec<u32> = versions.iter().map(|ver| ver.id()).collect();
+
+		let table = cache.records().bulk_fields(&ids, &fields).unwrap();
+		assert_eq!(table.len(), ids.len());
+
+		// Rows stay in the order they were asked for.
+		for (row, ver) in versions.iter().enumerate() {
+			for (col, field) in fields.iter().enumerate() {
+				assert_eq!(
+					table.get(row, col).map(str::to_string),
+					ver.get_record(*field)
+				);
+			}
+		}
+
+		// Single lookups still work after the bulk lookup moved the parser.
+		let cand = cache.get("apt").unwrap().candidate().unwrap();
+		assert_eq!(
+			cand.get_record(RecordField::Version).unwrap(),
+			cand.version()
+		);
+
+		assert!(cache.records().bulk_fields(&[u32::MAX], &fields).is_err());
+	}
+
+	#[test]
+	fn record_cache() {
+		let cache = new_cache!().unwrap();
+		let apt = cache.get("apt").unwrap().candidate().unwrap();
+		let dpkg = cache.get("dpkg").unwrap().candidate().unwrap();
+
+		let summary = apt.summary();
+		let sha256 = apt.sha256();
+		let start = cache.records().cache_stats();
+
+		// Going back and forth between versions shouldn't parse them again.
+		for _ in 0..3 {
+			assert_eq!(apt.summary(), summary);
+			assert!(dpkg.get_record(RecordField::Maintainer).is_some());
+			assert_eq!(apt.sha256(), sha256);
+			assert!(dpkg.summary().is_some());
+		}
+
+		let stats = cache.records().cache_stats();
+		assert_eq!(stats.ver_misses - start.ver_misses, 1);
+		assert_eq!(stats.desc_misses - start.desc_misses, 1);
+		assert_eq!(stats.ver_hits - start.ver_hits, 5);
+		assert_eq!(stats.desc_hits - start.desc_hits, 5);
+
+		// With one record of each kind, every switch is a miss.
+		// apt is still the newest version record.
+		cache.records().set_cache_size(1);
+		let start = cache.records().cache_stats();
+		assert_eq!(apt.sha256(), sha256);
+		assert!(dpkg.get_record(RecordField::Maintainer).is_some());
+		assert_eq!(apt.sha256(), sha256);
+
+		let stats = cache.records().cache_stats();
+		assert_eq!(stats.ver_hits - start.ver_hits, 1);
+		assert_eq!(stats.ver_misses - start.ver_misses, 2);
+	}
+
+	#[test]
+	fn parallel_fields() {
+		let cache = new_cache!().unwrap();
+		let fields = [
+			RecordField::Package,
+			RecordField::Version,
+			"SHA256",
+			"Description",
+		];
+
+		// Every version in the cache, in ID order.
+		let mut ids: Vec<u32> = cache
+			.iter()
+			.flat_map(|pkg| pkg.versions().map(|ver| ver.id()).collect::<Vec<_>>())
+			.collect();
+		ids.sort_unstable();
+
+		let expected = cache.records().bulk_fields(&ids, &fields).unwrap();
+		for threads in [0, 1, 3] {
+			let table = cache
+				.records()
+				.parallel_fields(&ids, &fields, threads)
+				.unwrap();
+			assert_eq!(table.offsets, expected.offsets);
+			assert_eq!(table.data, expected.data);
+		}
+
+		assert!(cache
+			.records()
+			.parallel_fields(&[u32::MAX], &fields, 0)
+			.is_err());
+	}
+
+	#[test]
+	fn borrowed_fields() {
+		let cache = new_cache!().unwrap();
+		let cand = cache.get("apt").unwrap().candidate().unwrap();
+		let other = cache.get("dpkg").unwrap().candidate().unwrap();
+
+		let record = cand.record().unwrap();
+		let desc = cand.description_record().unwrap();
+
+		// Other lookups don't move the record we're holding.
+		assert!(other.get_record(RecordField::Version).is_some());
+		assert!(other.summary().is_some());
+
+		assert_eq!(record.field(RecordField::Version).unwrap(), cand.version());
+		assert_eq!(
+			record
+				.field(RecordField::Maintainer)
+				.ok()
+				.map(str::to_string),
+			cand.get_record(RecordField::Maintainer)
+		);
+		assert!(record.field(RecordField::Homepage).is_err());
+		assert_eq!(
+			record.hash("sha256").ok().map(str::to_string),
+			cand.sha256()
+		);
+		assert_eq!(
+			record.hash("SHA256").ok().map(str::to_string),
+			cand.sha256()
+		);
+		assert_eq!(
+			desc.short_description().ok().map(str::to_string),
+			cand.summary()
+		);
+		assert_eq!(
+			desc.long_description().ok().map(str::to_string),
+			cand.description()
+		);
+
+		// Every field is in order, and agrees with looking it up by key.
+		let fields: Vec<(&str, &str)> = record.fields().collect();
+		assert_eq!(fields.len() as u32, record.field_count());
+		assert_eq!(fields[0], ("Package", "apt"));
+		for (key, value) in fields {
+			if !value.is_empty() {
+				assert_eq!(record.field(key).unwrap(), value);
+			}
+		}
+		assert!(record.key_at(record.field_count()).is_err());
+	}
+
+	#[test]
+	fn search_index() {
+		use oma_apt::raw::search::raw::SearchField;
+
+		let cache = new_cache!().unwrap();
+		let path = std::env::temp_dir().join(format!("oma-apt-search-{}.idx", std::process::id()));
+		let _ = std::fs::remove_file(&path);
+
+		let index = cache.search_index(&path).unwrap();
+		assert!(index.rebuilt());
+		assert!(index.term_count() > 0);
+
+		// Nothing changed, so the index on disk is used.
+		let index = cache.search_index(&path).unwrap();
+		assert!(!index.rebuilt());
+
+		let apt = cache.get("apt").unwrap();
+		let hits = index.search("APT");
+		let hit = hits.iter().find(|hit| hit.pkg_id == apt.id()).unwrap();
+		assert!(hit.matched(SearchField::Name));
+		// Name matches come first.
+		assert!(hits[0].matched(SearchField::Name));
+
+		// Every word of the summary finds the package.
+		let summary = apt.candidate().unwrap().summary().unwrap();
+		assert!(cache
+			.search(&index, &summary)
+			.unwrap()
+			.any(|pkg| pkg.id() == apt.id()));
+
+		// Words match the start of a word, and anywhere in a name.
+		assert!(index.search("ap").iter().any(|hit| hit.pkg_id == apt.id()));
+		let libapt = cache
+			.iter()
+			.find(|pkg| pkg.name().starts_with("libapt-pkg"))
+			.unwrap();
+		assert!(index
+			.search("apt")
+			.iter()
+			.any(|hit| hit.pkg_id == libapt.id()));
+
+		assert!(index.search("not-a-real-word-xyzzy").is_empty());
+		assert!(index.search("").is_empty());
+
+		std::fs::remove_file(&path).unwrap();
+	}
 }
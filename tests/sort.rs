@@ -77,6 +77,21 @@ mod sort {
 		assert!(!virtual_pkgs.is_empty());
 	}
 
+	#[test]
+	fn names() {
+		let cache = new_cache!().unwrap();
+
+		let sort = PackageSort::default().installed().names();
+		let names: Vec<String> = cache
+			.packages(&sort)
+			.unwrap()
+			.map(|pkg| pkg.name().to_string())
+			.collect();
+
+		assert!(!names.is_empty());
+		assert!(names.windows(2).all(|pair| pair[0] <= pair[1]));
+	}
+
 	#[test]
 	fn upgradable() {
 		let cache = new_cache!().unwrap();
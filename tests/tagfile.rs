@@ -1,5 +1,8 @@
 mod tagfile {
-	use oma_apt::tagfile::{self, TagSection};
+	use std::io::Read;
+
+	use oma_apt::raw::tagfile::raw::{open_deb_control, open_tagfile};
+	use oma_apt::tagfile::{self, TagReader, TagSection, TagSectionRef, TagSections};
 
 	#[test]
 	fn correct() {
@@ -46,4 +49,183 @@ mod tagfile {
 			"\n\tAll my homies know that tabs be superior.\n\t   Why not just use both?"
 		);
 	}
+
+	/// A reader that hands out a few bytes at a time,
+	/// so sections and blank lines are split between reads.
+	struct Trickle<'a>(&'a [u8]);
+
+	impl<'a> Read for Trickle<'a> {
+		fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+			let len = buf.len().min(self.0.len()).min(3);
+			buf[..len].copy_from_slice(&self.0[..len]);
+			self.0 = &self.0[len..];
+			Ok(len)
+		}
+	}
+
+	fn owned(section: TagSectionRef) -> Vec<(String, String)> {
+		let mut fields: Vec<_> = section
+			.fields()
+			.map(|(k, v)| (k.to_string(), v.to_string()))
+			.collect();
+		fields.sort();
+		fields
+	}
+
+	#[test]
+	fn streaming() {
+		let control_file = include_str!("files/tagfile/correct.control");
+		let dpkg_status = include_str!("/var/lib/dpkg/status");
+
+		for content in [control_file, dpkg_status] {
+			let sections: Vec<_> = TagSections::new(content.as_bytes())
+				.map(|section| owned(section.unwrap()))
+				.collect();
+
+			let mut reader = TagReader::new(Trickle(content.as_bytes()));
+			let mut streamed = vec![];
+			while let Some(section) = reader.next_section() {
+				streamed.push(owned(section.unwrap()));
+			}
+			assert_eq!(sections, streamed);
+
+			// Values match the owned parser, apart from empty values.
+			let expected = tagfile::parse_tagfile(content).unwrap();
+			assert_eq!(sections.len(), expected.len());
+			for (fields, section) in sections.iter().zip(expected) {
+				for (key, value) in fields {
+					if !value.is_empty() {
+						assert_eq!(section.get(key), Some(value));
+					}
+				}
+			}
+		}
+
+		let mut sections = TagSections::new(control_file.as_bytes());
+		let first = sections.next().unwrap().unwrap();
+		assert_eq!(first.line(), 1);
+		assert_eq!(
+			first.get("Multi-Line").unwrap(),
+			"Wow\n  This is\n  Multiple lines!"
+		);
+		assert_eq!(sections.next().unwrap().unwrap().line(), 9);
+		assert!(sections.next().is_none());
+
+		// Errors point at the line in the whole file.
+		let broken = "Package: one\n\n\nPackage: two\nBroken\n";
+		let mut sections = TagSections::new(broken.as_bytes());
+		assert!(sections.next().unwrap().is_ok());
+		assert_eq!(sections.next().unwrap().unwrap_err().line, Some(5));
+
+		let mut reader = TagReader::new(Trickle(broken.as_bytes()));
+		assert!(reader.next_section().unwrap().is_ok());
+		assert_eq!(reader.next_section().unwrap().unwrap_err().line, Some(5));
+
+		let section: TagSection = TagSections::new(b"Key: value")
+			.next()
+			.unwrap()
+			.unwrap()
+			.into();
+		assert_eq!(section.get("Key").unwrap(), "value");
+	}
+
+	#[test]
+	fn apt_tagfile() {
+		let dpkg_status = include_str!("/var/lib/dpkg/status");
+		let mut file = open_tagfile("/var/lib/dpkg/status").unwrap();
+
+		// Fields from apt match the Rust parser, section by section.
+		for expected in TagSections::new(dpkg_status.as_bytes()) {
+			let expected = expected.unwrap();
+			assert!(file.pin_mut().step().unwrap());
+
+			assert_eq!(
+				file.find("Package").unwrap(),
+				expected.get("Package").unwrap()
+			);
+			let fields: Vec<_> = file.fields().collect();
+			let expected: Vec<_> = expected.fields().collect();
+			assert_eq!(fields.len(), expected.len());
+			for ((key, value), (expected_key, expected_value)) in fields.iter().zip(expected) {
+				assert_eq!(*key, expected_key);
+				assert_eq!(*value, expected_value.trim());
+			}
+		}
+		assert!(!file.pin_mut().step().unwrap());
+
+		let mut control = open_deb_control("tests/files/cache/dep-pkg1_0.0.1.deb").unwrap();
+		assert!(control.find("Package").is_err());
+		assert!(control.pin_mut().step().unwrap());
+		assert_eq!(control.find("Package").unwrap(), "dep-pkg1");
+		assert_eq!(control.find("Version").unwrap(), "0.0.1");
+		assert!(!control.pin_mut().step().unwrap());
+
+		assert!(open_tagfile("tests/files/this-file-doesnt-exist").is_err());
+		assert!(open_deb_control("tests/files/cache/pkg.deb").is_err());
+	}
+
+	#[test]
+	fn compressed_tagfile() {
+		let control_file = include_str!("files/tagfile/correct.control");
+
+		// Compressed files are read through the same parser as the plain file.
+		for path in [
+			"tests/files/tagfile/correct.control.gz",
+			"tests/files/tagfile/correct.control.xz",
+		] {
+			let mut file = open_tagfile(path).unwrap();
+			let mut next_offset = 0;
+			for expected in TagSections::new(control_file.as_bytes()) {
+				let expected = expected.unwrap();
+				assert!(file.pin_mut().step().unwrap());
+
+				// The offset is where the section starts in the decompressed file.
+				let offset = file.offset() as usize;
+				let text = file.section_text().unwrap();
+				assert!(offset >= next_offset);
+				assert_eq!(&control_file[offset..offset + text.len()], text);
+				next_offset = offset + text.len();
+
+				let fields: Vec<_> = file.fields().collect();
+				let expected: Vec<_> = expected.fields().collect();
+				assert_eq!(fields.len(), expected.len());
+				for ((key, value), (expected_key, expected_value)) in fields.iter().zip(expected) {
+					assert_eq!(*key, expected_key);
+					assert_eq!(*value, expected_value.trim());
+				}
+			}
+			assert!(!file.pin_mut().step().unwrap());
+		}
+	}
+
+	#[test]
+	fn parallel() {
+		let dpkg_status = include_str!("/var/lib/dpkg/status");
+		let expected = tagfile::parse_tagfile(dpkg_status).unwrap();
+
+		for threads in [0, 1, 2, 7, 64] {
+			let sections = tagfile::parse_tagfile_parallel(dpkg_status, threads).unwrap();
+			assert_eq!(sections.len(), expected.len());
+			for (section, expected) in sections.iter().zip(&expected) {
+				assert_eq!(section.hashmap(), expected.hashmap());
+			}
+		}
+
+		// Build a file with an error far into it, past extra blank lines.
+		let mut content = String::new();
+		for index in 0..200 {
+			content += &format!("Package: pkg{index}\nVersion: 1.0\n\n\n");
+		}
+		content += "Package: broken\nNo separator\n";
+
+		// Every section is 4 lines, the error is on the second line after them.
+		let err = tagfile::parse_tagfile(&content).err().unwrap();
+		assert_eq!(err.line, Some(200 * 4 + 2));
+		for threads in [2, 3, 16] {
+			let err = tagfile::parse_tagfile_parallel(&content, threads)
+				.err()
+				.unwrap();
+			assert_eq!(err.line, Some(200 * 4 + 2));
+		}
+	}
 }
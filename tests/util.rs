@@ -12,4 +12,126 @@ mod util {
 		assert_eq!(Ordering::Equal, util::cmp_versions(ver1, ver1));
 		assert_eq!(Ordering::Greater, util::cmp_versions(ver2, ver1));
 	}
+
+	#[test]
+	fn version_key() {
+		let versions = [
+			"0",
+			"1",
+			"01",
+			"1.0",
+			"1.0~rc1",
+			"1.0~~",
+			"1.0~",
+			"1.0a",
+			"1.0+b1",
+			"1.0.0",
+			"1.0-0",
+			"1.0-1",
+			"1.0-1ubuntu1",
+			"1.0-1~bpo1",
+			"1:0.9",
+			"0:1.0",
+			"2:1",
+			"1.2.10",
+			"1.2.9",
+			"1.0-a-b",
+			"a",
+			"A",
+			"1.0.",
+			"1..0",
+			"10",
+			"9",
+			"1.0-1.1",
+		];
+
+		for ver1 in versions {
+			for ver2 in versions {
+				assert_eq!(
+					util::cmp_versions(ver1, ver2),
+					util::version_key(ver1).cmp(&util::version_key(ver2)),
+					"{ver1} and {ver2}",
+				);
+			}
+		}
+	}
+
+	#[test]
+	fn cached_version_keys() {
+		let cache = oma_apt::new_cache!().unwrap();
+
+		for pkg in cache.packages(&Default::default()).unwrap().take(500) {
+			let versions: Vec<_> = pkg.versions().collect();
+			for ver1 in &versions {
+				assert_eq!(ver1.sort_key().unwrap(), util::version_key(ver1.version()));
+				for ver2 in &versions {
+					assert_eq!(
+						ver1.partial_cmp(ver2),
+						Some(util::cmp_versions(ver1.version(), ver2.version())),
+					);
+				}
+			}
+		}
+		assert!(cache.version_key(u32::MAX).is_none());
+	}
+
+	/// Every version string in the cache.
+	fn real_versions() -> Vec<String> {
+		let cache = oma_apt::new_cache!().unwrap();
+		let mut versions: Vec<String> = cache
+			.packages(&Default::default())
+			.unwrap()
+			.flat_map(|pkg| {
+				pkg.versions()
+					.map(|ver| ver.version().to_string())
+					.collect::<Vec<_>>()
+			})
+			.collect();
+		versions.sort();
+		versions.dedup();
+		versions
+	}
+
+	#[test]
+	fn bulk_versions() {
+		let mut versions = real_versions();
+		assert!(!versions.is_empty());
+
+		util::sort_versions(&mut versions);
+		for pair in versions.windows(2) {
+			assert_ne!(
+				Ordering::Greater,
+				util::cmp_versions(&pair[0], &pair[1]),
+				"{} and {}",
+				pair[0],
+				pair[1],
+			);
+		}
+
+		let strs: Vec<&str> = versions.iter().map(|ver| ver.as_str()).collect();
+		let max = util::max_version(&strs).unwrap();
+		for ver in &strs {
+			assert_ne!(Ordering::Greater, util::cmp_versions(ver, max));
+		}
+		assert_eq!(util::max_version(&[]), None);
+
+		let target = strs[strs.len() / 2];
+		for (op, expected) in [
+			("<<", vec![Ordering::Less]),
+			("<=", vec![Ordering::Less, Ordering::Equal]),
+			("=", vec![Ordering::Equal]),
+			("!=", vec![Ordering::Less, Ordering::Greater]),
+			(">=", vec![Ordering::Equal, Ordering::Greater]),
+			(">>", vec![Ordering::Greater]),
+		] {
+			let satisfying = util::filter_satisfying(&strs, op, target).unwrap();
+			let wanted: Vec<&str> = strs
+				.iter()
+				.copied()
+				.filter(|ver| expected.contains(&util::cmp_versions(ver, target)))
+				.collect();
+			assert_eq!(satisfying, wanted, "{op} {target}");
+		}
+		assert!(util::filter_satisfying(&strs, "~=", target).is_err());
+	}
 }